@@ -11,20 +11,190 @@
 #include "ns3/node.h"
 #include "ns3/flow-monitor-module.h"
 #include "ns3/flow-monitor-helper.h"
-
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
+
+#include "compact-animation.h"
+#include "event-profiler.h"
+#include "ladder-scheduler.h"
+#include "route-tracker.h"
+#include "routing-cache.h"
+#include "sim-perf.h"
+
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("NetworkTopology");
 
+/**
+ * Writes the statistics of every flow seen by a FlowMonitor to a CSV file at a
+ * fixed interval, one line per flow active during the interval.
+ *
+ * Delay, jitter, loss and throughput are computed over the interval only, from
+ * the difference with the counters of the previous export. Export() must be
+ * called once more at the end of the simulation for its last interval.
+ */
+class FlowStatsExporter {
+  public:
+    FlowStatsExporter(Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier, std::string fileName, Time interval);
+    void Export();
+
+  private:
+    void ExportPeriodically();
+
+    Ptr<FlowMonitor> m_monitor;
+    Ptr<Ipv4FlowClassifier> m_classifier;
+    std::ofstream m_file;
+    Time m_interval;
+    Time m_lastExport; //!< Time of the previous export
+    std::map<FlowId, FlowMonitor::FlowStats> m_last; //!< Counters at the previous export
+};
+
+FlowStatsExporter::FlowStatsExporter(Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier, std::string fileName, Time interval)
+    : m_monitor(monitor), m_classifier(classifier), m_file(fileName), m_interval(interval), m_lastExport(Simulator::Now()) {
+    m_file << "time,flow,source,destination,protocol,sourcePort,destinationPort,"
+              "txPackets,rxPackets,lostPackets,delayMs,jitterMs,throughputMbps" << std::endl;
+    Simulator::Schedule(m_interval, &FlowStatsExporter::ExportPeriodically, this);
+}
+
+void FlowStatsExporter::ExportPeriodically() {
+    Export();
+    Simulator::Schedule(m_interval, &FlowStatsExporter::ExportPeriodically, this);
+}
+
+void FlowStatsExporter::Export() {
+    // The last interval, up to the end of the simulation, may be shorter
+    double elapsed = (Simulator::Now() - m_lastExport).GetSeconds();
+    if (elapsed <= 0) {
+        return;
+    }
+    m_lastExport = Simulator::Now();
+    m_monitor->CheckForLostPackets();
+    for (const auto &flow : m_monitor->GetFlowStats()) {
+        const FlowMonitor::FlowStats &stats = flow.second;
+        FlowMonitor::FlowStats &last = m_last[flow.first];
+        uint32_t txPackets = stats.txPackets - last.txPackets;
+        uint32_t rxPackets = stats.rxPackets - last.rxPackets;
+        uint32_t lostPackets = stats.lostPackets - last.lostPackets;
+        if (txPackets == 0 && rxPackets == 0 && lostPackets == 0) {
+            continue;
+        }
+        // The jitter is summed over every received packet but the first one of the flow
+        uint32_t jitterPackets = last.rxPackets == 0 && rxPackets > 0 ? rxPackets - 1 : rxPackets;
+        double delay = rxPackets ? (stats.delaySum - last.delaySum).GetSeconds() * 1000 / rxPackets : 0;
+        double jitter = jitterPackets ? (stats.jitterSum - last.jitterSum).GetSeconds() * 1000 / jitterPackets : 0;
+        double throughput = (stats.rxBytes - last.rxBytes) * 8.0 / elapsed / 1000000;
+
+        Ipv4FlowClassifier::FiveTuple tuple = m_classifier->FindFlow(flow.first);
+        m_file << Simulator::Now().GetSeconds() << "," << flow.first << ","
+               << tuple.sourceAddress << "," << tuple.destinationAddress << ","
+               << static_cast<uint32_t>(tuple.protocol) << "," << tuple.sourcePort << ","
+               << tuple.destinationPort << "," << txPackets << "," << rxPackets << ","
+               << lostPackets << "," << delay << "," << jitter << "," << throughput << "\n";
+        last = stats;
+    }
+    m_file.flush();
+}
+
 int main(int argc, char *argv[]) {
+    PerfReport perf;
+    bool verbose = false;
+    bool headless = false;
+    std::string perfReport = "";
+    bool flowmon = true;
+    double flowmonInterval = 0.5;
+    std::string flowmonFile = "PedagogicalCase-flowmon.csv";
+    std::string routingCache = "";
+    std::string animFormat = "xml";
+    uint32_t animSample = 1;
+    bool animPerFlow = false;
+    double animStart = 0;
+    double animStop = 0;
+    std::string routeTracking = "events";
+    std::string profile = "";
+    std::string scheduler = "map";
+#ifdef NS3_MPI
+    bool mpi = false;
+    bool nullmsg = false;
+#endif
+
     CommandLine cmd;
+    cmd.AddValue("flowmon", "Monitor the flows of the internet node and of CSMA3", flowmon);
+    cmd.AddValue("flowmonInterval", "Interval between two flow statistics exports [s]", flowmonInterval);
+    cmd.AddValue("flowmonFile", "CSV file the flow statistics are written to", flowmonFile);
+    cmd.AddValue("headless", "Disable logging, packet capture and animation", headless);
+    cmd.AddValue("perfReport", "Append a performance report of the run to this file", perfReport);
+    cmd.AddValue("routingCache", "Load the routing tables from this file, or save them there if the topology changed", routingCache);
+    cmd.AddValue("animFormat", "Animation: xml (NetAnim), binary (compact, see anim-convert) or none", animFormat);
+    cmd.AddValue("animSample", "Binary animation: record 1 packet in animSample", animSample);
+    cmd.AddValue("animPerFlow", "Binary animation: sample 1 flow in animSample instead of packets", animPerFlow);
+    cmd.AddValue("animStart", "Binary animation: start of the recording [s]", animStart);
+    cmd.AddValue("animStop", "Binary animation: end of the recording, 0 until the end [s]", animStop);
+    cmd.AddValue("routeTracking", "Routing table changes: events (when routes are computed), poll (every second), xml (NetAnim full dumps, needs animFormat=xml) or none", routeTracking);
+    cmd.AddValue("profile", "Profile the events by target function, the report is written to this file", profile);
+    cmd.AddValue("scheduler", "Event scheduler: map, heap, list, calendar or ladder", scheduler);
+#ifdef NS3_MPI
+    cmd.AddValue("mpi", "Run distributed on 2 MPI ranks, the internet node on rank 1", mpi);
+    cmd.AddValue("nullmsg", "Use the null message distributed scheduler", nullmsg);
+#endif
     cmd.Parse(argc, argv);
-    bool verbose = false;
+    NS_ABORT_MSG_IF(flowmon && flowmonInterval <= 0, "flowmonInterval must be positive");
+
+    SetSchedulerType(scheduler);
+    if (!profile.empty()) {
+#ifdef NS3_MPI
+        NS_ABORT_MSG_IF(mpi, "The profiler cannot be used in a distributed run");
+#endif
+        ProfilingSimulatorImpl::Enable(profile);
+    }
+
+    // Rank of this process. The campus runs on rank 0 and the internet node on rank 1, the
+    // 10 ms point-to-point link between them is the lookahead of the distributed scheduler.
+    // Only point-to-point links may cross ranks, so the bridged LANs cannot be split.
+    uint32_t systemId = 0;
+    uint32_t systemCount = 1;
+#ifdef NS3_MPI
+    if (mpi) {
+        if (nullmsg) {
+            GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::NullMessageSimulatorImpl"));
+        } else {
+            GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DistributedSimulatorImpl"));
+        }
+        MpiInterface::Enable(&argc, &argv);
+        systemId = MpiInterface::GetSystemId();
+        systemCount = MpiInterface::GetSize();
+        NS_ABORT_MSG_IF(systemCount != 2, "The distributed simulation runs on exactly 2 ranks");
+    }
+#endif
+    bool distributed = systemCount > 1;
+
+    // A flow is only followed by the monitor that saw its packets sent, each rank would
+    // see one end of the flow
+    if (distributed && flowmon) {
+        std::cout << "Flow monitoring is not available in a distributed run" << std::endl;
+        flowmon = false;
+    }
+
+    NS_ABORT_MSG_IF(animFormat != "xml" && animFormat != "binary" && animFormat != "none",
+                    "animFormat must be xml, binary or none");
+    // The animation needs every node on a single rank
+    if (headless || distributed) {
+        animFormat = "none";
+    }
+    NS_ABORT_MSG_IF(routeTracking != "events" && routeTracking != "poll" && routeTracking != "xml" && routeTracking != "none",
+                    "routeTracking must be events, poll, xml or none");
+    // Every rank holds the same routes, the first one tracks them
+    if (headless || systemId != 0) {
+        routeTracking = "none";
+    }
 
     // Enable log components
-    if (verbose) {
+    if (verbose && !headless) {
         LogComponentEnable("NetworkTopology", LOG_LEVEL_INFO);
         LogComponentEnable("CsmaChannel", LOG_LEVEL_INFO);
         LogComponentEnable("Ipv4L3Protocol", LOG_LEVEL_INFO);
@@ -34,12 +204,6 @@ int main(int argc, char *argv[]) {
         LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
     }
 
-    // Flow monitor
-    Ptr<FlowMonitor> flowMonitor;
-    FlowMonitorHelper flowHelper;
-    flowMonitor = flowHelper.InstallAll();
-
-
     NS_LOG_INFO("Creating nodes.");
     NodeContainer csmaNodes0, csmaNodes1, csmaNodes2, csmaNodes3, routerNode, internetNode;
     csmaNodes0.Create(3);
@@ -47,7 +211,7 @@ int main(int argc, char *argv[]) {
     csmaNodes2.Create(3);
     csmaNodes3.Create(1);
     routerNode.Create(4);
-    internetNode.Create(1);
+    internetNode.Create(1, distributed ? 1 : 0);
 
     NodeContainer switchNode;
     switchNode.Create(3); // This node will not have an IP stack.
@@ -159,7 +323,38 @@ int main(int argc, char *argv[]) {
     Ipv4InterfaceContainer routerToInternetInterfaces = address.Assign(routerToInternetDevices);
 
     NS_LOG_INFO("Populating routing tables.");
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    // Every rank computes the routes of all nodes, so each one keeps its own cache file
+    if (!routingCache.empty() && distributed) {
+        routingCache += ".rank" + std::to_string(systemId);
+    }
+    RoutingCache routing;
+    std::unique_ptr<RouteTracker> routeTracker;
+    if (routeTracking == "events" || routeTracking == "poll") {
+        routeTracker = std::make_unique<RouteTracker>("PedagogicalCase-routes.txt");
+    }
+    if (routeTracking == "events") {
+        // The first computation of the routes makes the snapshot at start
+        routing.AddRoutesChangedCallback(MakeCallback(&RouteTracker::Track, routeTracker.get()));
+    } else if (routeTracking == "poll") {
+        routeTracker->Poll(Seconds(1.0), Seconds(10.0), Seconds(1.0));
+    }
+    if (routing.Populate(routingCache)) {
+        NS_LOG_INFO("Routing tables loaded from " << routingCache);
+    }
+
+    // Flow monitor, installed once the stack is in place and only on the flow end points so
+    // that routers do not classify every packet they forward
+    FlowMonitorHelper flowHelper;
+    Ptr<FlowMonitor> flowMonitor;
+    std::unique_ptr<FlowStatsExporter> flowExporter;
+    if (flowmon) {
+        NS_LOG_INFO("Installing flow monitor.");
+        flowMonitor = flowHelper.Install(NodeContainer(internetNode, csmaNodes3));
+        flowExporter = std::make_unique<FlowStatsExporter>(flowMonitor,
+                                                           DynamicCast<Ipv4FlowClassifier>(flowHelper.GetClassifier()),
+                                                           flowmonFile,
+                                                           Seconds(flowmonInterval));
+    }
 
     NS_LOG_INFO("Creating applications.");
 /*
@@ -194,106 +389,148 @@ int main(int argc, char *argv[]) {
     clientApps6.Stop(Seconds(5.0));
 */
     // Send TCP packets from internet node 0 to csma 3 node 0
-    PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(csma3Interfaces.GetAddress(1), 15));
-    ApplicationContainer serverApps7 = sink.Install(csmaNodes3.Get(0));
-    serverApps7.Start(Seconds(1.0));
-    serverApps7.Stop(Seconds(5.0));
-
-    OnOffHelper onoff("ns3::TcpSocketFactory", InetSocketAddress(csma3Interfaces.GetAddress(1), 15));
-    onoff.SetAttribute("PacketSize", UintegerValue(1024));
-    onoff.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1]"));
-    onoff.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
-    onoff.SetAttribute("DataRate", StringValue("1Mbps"));
-
-    ApplicationContainer clientApps7 = onoff.Install(internetNode.Get(0));
-    clientApps7.Start(Seconds(1.0));
-    clientApps7.Stop(Seconds(5.0));
-
-    NS_LOG_INFO("Creating animation interface.");
-    AnimationInterface anim("PedagogicalCase.xml");
-    anim.EnablePacketMetadata(true);
-    anim.EnableIpv4RouteTracking("PedagogicalCase-routing.xml", Seconds(1.0), Seconds(10.0), Seconds(1.0));
-    // Set node positions
-    anim.SetConstantPosition(csmaNodes2.Get(0), 98.0, 20.0);
-    anim.SetConstantPosition(csmaNodes2.Get(1), 98.0, 40.0);
-    anim.SetConstantPosition(csmaNodes2.Get(2), 98.0, 60.0);
-    anim.SetConstantPosition(csmaNodes1.Get(0), 20.0, 10.0);
-    anim.SetConstantPosition(csmaNodes1.Get(1), 40.0, 10.0);
-    anim.SetConstantPosition(csmaNodes1.Get(2), 60.0, 10.0);
-    anim.SetConstantPosition(csmaNodes0.Get(0), 10.0, 85.0);
-    anim.SetConstantPosition(csmaNodes0.Get(1), 30.0, 85.0);
-    anim.SetConstantPosition(csmaNodes0.Get(2), 50.0, 85.0);
-    anim.SetConstantPosition(switchNode.Get(1), 40.0, 20.0);
-    anim.SetConstantPosition(switchNode.Get(0), 80.0, 40.0);
-    anim.SetConstantPosition(routerNode.Get(0), 90.0, 75.0);
-    anim.SetConstantPosition(routerNode.Get(1), 80.0, 10.0);
-    anim.SetConstantPosition(internetNode.Get(0), 90.0, 95.0);
-    anim.SetConstantPosition(switchNode.Get(2), 30.0, 75.0);
-    anim.SetConstantPosition(routerNode.Get(2), 50.0, 70.0);
-    anim.SetConstantPosition(routerNode.Get(3), 15.0, 60.0);
-    anim.SetConstantPosition(csmaNodes3.Get(0), 15.0, 50.0);
-
-    // Update node images
-    uint32_t router_img = anim.AddResource("/home/tom/repos/ns-3-dev/netanim/images/1200px-Router.svg.png");
-    uint32_t switch_img = anim.AddResource("/home/tom/repos/ns-3-dev/netanim/images/core-switch.png");
-    uint32_t pc_img = anim.AddResource("/home/tom/repos/ns-3-dev/netanim/images/vecteezy_monitor-icon-sign-symbol-design_10158482.png");
+    // Applications are only installed by the rank that owns their node
+    if (csmaNodes3.Get(0)->GetSystemId() == systemId) {
+        PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(csma3Interfaces.GetAddress(1), 15));
+        ApplicationContainer serverApps7 = sink.Install(csmaNodes3.Get(0));
+        serverApps7.Start(Seconds(1.0));
+        serverApps7.Stop(Seconds(5.0));
+    }
 
-    for (int i = 0; i < 3; ++i) {
-        anim.UpdateNodeImage(csmaNodes2.Get(i)->GetId(), pc_img);
-        anim.UpdateNodeImage(csmaNodes1.Get(i)->GetId(), pc_img);
-        anim.UpdateNodeImage(csmaNodes0.Get(i)->GetId(), pc_img);
+    if (internetNode.Get(0)->GetSystemId() == systemId) {
+        OnOffHelper onoff("ns3::TcpSocketFactory", InetSocketAddress(csma3Interfaces.GetAddress(1), 15));
+        onoff.SetAttribute("PacketSize", UintegerValue(1024));
+        onoff.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1]"));
+        onoff.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
+        onoff.SetAttribute("DataRate", StringValue("1Mbps"));
+
+        ApplicationContainer clientApps7 = onoff.Install(internetNode.Get(0));
+        clientApps7.Start(Seconds(1.0));
+        clientApps7.Stop(Seconds(5.0));
     }
-    anim.UpdateNodeImage(csmaNodes3.Get(0)->GetId(), pc_img);
-    anim.UpdateNodeImage(routerNode.Get(0)->GetId(), router_img);
-    anim.UpdateNodeImage(routerNode.Get(1)->GetId(), router_img);
-    anim.UpdateNodeImage(routerNode.Get(2)->GetId(), router_img);
-    anim.UpdateNodeImage(routerNode.Get(3)->GetId(), router_img);
-    anim.UpdateNodeImage(switchNode.Get(2)->GetId(), switch_img);
-    anim.UpdateNodeImage(switchNode.Get(0)->GetId(), switch_img);
-    anim.UpdateNodeImage(switchNode.Get(1)->GetId(), switch_img);
-    anim.UpdateNodeImage(internetNode.Get(0)->GetId(), pc_img);
-
-    // Update node sizes
-    for (int i = 0; i < 3; ++i) {
-        anim.UpdateNodeSize(csmaNodes1.Get(i), 6.0, 6.0);
-        anim.UpdateNodeSize(csmaNodes2.Get(i), 6.0, 6.0);
-        anim.UpdateNodeSize(csmaNodes0.Get(i), 6.0, 6.0);
+
+    // Node positions, shared by both animation formats
+    if (animFormat != "none") {
+        AnimationInterface::SetConstantPosition(csmaNodes2.Get(0), 98.0, 20.0);
+        AnimationInterface::SetConstantPosition(csmaNodes2.Get(1), 98.0, 40.0);
+        AnimationInterface::SetConstantPosition(csmaNodes2.Get(2), 98.0, 60.0);
+        AnimationInterface::SetConstantPosition(csmaNodes1.Get(0), 20.0, 10.0);
+        AnimationInterface::SetConstantPosition(csmaNodes1.Get(1), 40.0, 10.0);
+        AnimationInterface::SetConstantPosition(csmaNodes1.Get(2), 60.0, 10.0);
+        AnimationInterface::SetConstantPosition(csmaNodes0.Get(0), 10.0, 85.0);
+        AnimationInterface::SetConstantPosition(csmaNodes0.Get(1), 30.0, 85.0);
+        AnimationInterface::SetConstantPosition(csmaNodes0.Get(2), 50.0, 85.0);
+        AnimationInterface::SetConstantPosition(switchNode.Get(1), 40.0, 20.0);
+        AnimationInterface::SetConstantPosition(switchNode.Get(0), 80.0, 40.0);
+        AnimationInterface::SetConstantPosition(routerNode.Get(0), 90.0, 75.0);
+        AnimationInterface::SetConstantPosition(routerNode.Get(1), 80.0, 10.0);
+        AnimationInterface::SetConstantPosition(internetNode.Get(0), 90.0, 95.0);
+        AnimationInterface::SetConstantPosition(switchNode.Get(2), 30.0, 75.0);
+        AnimationInterface::SetConstantPosition(routerNode.Get(2), 50.0, 70.0);
+        AnimationInterface::SetConstantPosition(routerNode.Get(3), 15.0, 60.0);
+        AnimationInterface::SetConstantPosition(csmaNodes3.Get(0), 15.0, 50.0);
+    }
+
+    std::unique_ptr<AnimationInterface> anim;
+    std::unique_ptr<CompactAnimation> compactAnim;
+    if (animFormat == "xml") {
+        NS_LOG_INFO("Creating animation interface.");
+        anim = std::make_unique<AnimationInterface>("PedagogicalCase.xml");
+        anim->EnablePacketMetadata(true);
+        if (routeTracking == "xml") {
+            anim->EnableIpv4RouteTracking("PedagogicalCase-routing.xml", Seconds(1.0), Seconds(10.0), Seconds(1.0));
+        }
+
+        // Update node images
+        uint32_t router_img = anim->AddResource("/home/tom/repos/ns-3-dev/netanim/images/1200px-Router.svg.png");
+        uint32_t switch_img = anim->AddResource("/home/tom/repos/ns-3-dev/netanim/images/core-switch.png");
+        uint32_t pc_img = anim->AddResource("/home/tom/repos/ns-3-dev/netanim/images/vecteezy_monitor-icon-sign-symbol-design_10158482.png");
+
+        for (int i = 0; i < 3; ++i) {
+            anim->UpdateNodeImage(csmaNodes2.Get(i)->GetId(), pc_img);
+            anim->UpdateNodeImage(csmaNodes1.Get(i)->GetId(), pc_img);
+            anim->UpdateNodeImage(csmaNodes0.Get(i)->GetId(), pc_img);
+        }
+        anim->UpdateNodeImage(csmaNodes3.Get(0)->GetId(), pc_img);
+        anim->UpdateNodeImage(routerNode.Get(0)->GetId(), router_img);
+        anim->UpdateNodeImage(routerNode.Get(1)->GetId(), router_img);
+        anim->UpdateNodeImage(routerNode.Get(2)->GetId(), router_img);
+        anim->UpdateNodeImage(routerNode.Get(3)->GetId(), router_img);
+        anim->UpdateNodeImage(switchNode.Get(2)->GetId(), switch_img);
+        anim->UpdateNodeImage(switchNode.Get(0)->GetId(), switch_img);
+        anim->UpdateNodeImage(switchNode.Get(1)->GetId(), switch_img);
+        anim->UpdateNodeImage(internetNode.Get(0)->GetId(), pc_img);
+
+        // Update node sizes
+        for (int i = 0; i < 3; ++i) {
+            anim->UpdateNodeSize(csmaNodes1.Get(i), 6.0, 6.0);
+            anim->UpdateNodeSize(csmaNodes2.Get(i), 6.0, 6.0);
+            anim->UpdateNodeSize(csmaNodes0.Get(i), 6.0, 6.0);
+        }
+
+        anim->UpdateNodeSize(csmaNodes3.Get(0), 6.0, 6.0);
+        anim->UpdateNodeSize(switchNode.Get(0), 6.0, 6.0);
+        anim->UpdateNodeSize(switchNode.Get(1), 6.0, 6.0);
+        anim->UpdateNodeSize(switchNode.Get(2), 6.0, 6.0);
+        anim->UpdateNodeSize(routerNode.Get(0), 6.0, 6.0);
+        anim->UpdateNodeSize(routerNode.Get(1), 6.0, 6.0);
+        anim->UpdateNodeSize(routerNode.Get(2), 6.0, 6.0);
+        anim->UpdateNodeSize(routerNode.Get(3), 6.0, 6.0);
+        anim->UpdateNodeSize(internetNode.Get(0), 6.0, 6.0);
+
+        // Update node descriptions
+        // Let's start with the routers
+        anim->UpdateNodeDescription(routerNode.Get(0), "ROU 2");
+        anim->UpdateNodeDescription(routerNode.Get(1), "ROU 1");
+        anim->UpdateNodeDescription(routerNode.Get(2), "ROU 0");
+        anim->UpdateNodeDescription(routerNode.Get(3), "ROU 3");
+
+        // Now the switches
+        anim->UpdateNodeDescription(switchNode.Get(0), "SW 2");
+        anim->UpdateNodeDescription(switchNode.Get(1), "SW 1");
+        anim->UpdateNodeDescription(switchNode.Get(2), "SW 0");
+    } else if (animFormat == "binary") {
+        // Sampled binary animation, converted to NetAnim XML offline by anim-convert
+        compactAnim = std::make_unique<CompactAnimation>("PedagogicalCase.nsa");
+        compactAnim->SetSampling(animSample, animPerFlow);
+        compactAnim->SetWindow(Seconds(animStart), Seconds(animStop));
+        compactAnim->UpdateNodeDescription(routerNode.Get(0), "ROU 2");
+        compactAnim->UpdateNodeDescription(routerNode.Get(1), "ROU 1");
+        compactAnim->UpdateNodeDescription(routerNode.Get(2), "ROU 0");
+        compactAnim->UpdateNodeDescription(routerNode.Get(3), "ROU 3");
+        compactAnim->UpdateNodeDescription(switchNode.Get(0), "SW 2");
+        compactAnim->UpdateNodeDescription(switchNode.Get(1), "SW 1");
+        compactAnim->UpdateNodeDescription(switchNode.Get(2), "SW 0");
+        compactAnim->Install();
     }
-    
-    anim.UpdateNodeSize(csmaNodes3.Get(0), 6.0, 6.0);
-    anim.UpdateNodeSize(switchNode.Get(0), 6.0, 6.0);
-    anim.UpdateNodeSize(switchNode.Get(1), 6.0, 6.0);
-    anim.UpdateNodeSize(switchNode.Get(2), 6.0, 6.0);
-    anim.UpdateNodeSize(routerNode.Get(0), 6.0, 6.0);
-    anim.UpdateNodeSize(routerNode.Get(1), 6.0, 6.0);
-    anim.UpdateNodeSize(routerNode.Get(2), 6.0, 6.0);
-    anim.UpdateNodeSize(routerNode.Get(3), 6.0, 6.0);
-    anim.UpdateNodeSize(internetNode.Get(0), 6.0, 6.0);
-
-    // Update node descriptions
-    // Let's start with the routers
-    anim.UpdateNodeDescription(routerNode.Get(0), "ROU 2");
-    anim.UpdateNodeDescription(routerNode.Get(1), "ROU 1");
-    anim.UpdateNodeDescription(routerNode.Get(2), "ROU 0");
-    anim.UpdateNodeDescription(routerNode.Get(3), "ROU 3");
-
-    // Now the switches
-    anim.UpdateNodeDescription(switchNode.Get(0), "SW 2");
-    anim.UpdateNodeDescription(switchNode.Get(1), "SW 1");
-    anim.UpdateNodeDescription(switchNode.Get(2), "SW 0");
 
 
     //Simulator::Schedule(Seconds(5.0), &PrintArpCache, routerNode.Get(2));
-    csma.EnablePcap("Router1", router1ToSwitch1Link.Get(0), true);
+    if (!headless && routerNode.Get(1)->GetSystemId() == systemId) {
+        csma.EnablePcap("Router1", router1ToSwitch1Link.Get(0), true);
+    }
 
 
     Simulator::Stop(Seconds(10));
+    perf.Start();
     Simulator::Run();
-
-    //flowMonitor->SerializeToXmlFile("pedagogicalCase-flowmon.xml", true, true);
-
-
+    perf.Stop();
+    if (flowExporter) {
+        flowExporter->Export();
+    }
+    if (!perfReport.empty()) {
+        std::string parameters = PerfReport::GetArguments(argc, argv);
+        if (distributed) {
+            parameters += " rank=" + std::to_string(systemId);
+        }
+        perf.Write(perfReport, "PedagogicalCase", parameters);
+    }
     Simulator::Destroy();
+#ifdef NS3_MPI
+    if (mpi) {
+        MpiInterface::Disable();
+    }
+#endif
 
     return 0;
 }
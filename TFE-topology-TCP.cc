@@ -6,17 +6,143 @@
 #include "ns3/csma-module.h"
 #include "ns3/animation-interface.h"
 
+#include "async-log.h"
+#include "compact-animation.h"
+#include "event-profiler.h"
+#include "flow-metrics.h"
+#include "ladder-scheduler.h"
+#include "packet-pool.h"
+#include "replication-runner.h"
+#include "routing-cache.h"
+#include "sim-perf.h"
+#include "warm-fork.h"
+
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
 using namespace ns3;
 
 int main(int argc, char *argv[]) {
-    CommandLine cmd;
-    cmd.Parse(argc, argv);
+    PerfReport perf;
     bool verbose = true;
     std::string filename = "TFE-topology-TCP.xml";
     //bool tracing = true;   
     bool animation = true;
+    bool tracing = true;
+    bool headless = false;
+    std::string perfReport = "";
+    std::string routingCache = "";
+    std::string animFormat = "xml";
+    uint32_t animSample = 1;
+    bool animPerFlow = false;
+    double animStart = 0;
+    double animStop = 0;
+    std::string logSink = "text";
+    std::string logFile = "TFE-topology-TCP.nslog";
+    std::string profile = "";
+    std::string scheduler = "map";
+    bool packetPool = false;
+    bool poolStats = false;
+    double forkAt = 0;
+    std::string forkRates = "";
+    uint32_t replications = 1;
+    uint32_t minReplications = 3;
+    double replicationPrecision = 0.05;
+
+    CommandLine cmd;
+    cmd.AddValue("verbose", "Enable the TCP and application logs", verbose);
+    cmd.AddValue("animation", "Write the NetAnim trace", animation);
+    cmd.AddValue("tracing", "Enable pcap tracing", tracing);
+    cmd.AddValue("headless", "Disable logging, packet capture and animation", headless);
+    cmd.AddValue("perfReport", "Append a performance report of the run to this file", perfReport);
+    cmd.AddValue("routingCache", "Load the routing tables from this file, or save them there if the topology changed", routingCache);
+    cmd.AddValue("animFormat", "Animation: xml (NetAnim), binary (compact, see anim-convert) or none", animFormat);
+    cmd.AddValue("animSample", "Binary animation: record 1 packet in animSample", animSample);
+    cmd.AddValue("animPerFlow", "Binary animation: sample 1 flow in animSample instead of packets", animPerFlow);
+    cmd.AddValue("animStart", "Binary animation: start of the recording [s]", animStart);
+    cmd.AddValue("animStop", "Binary animation: end of the recording, 0 until the end [s]", animStop);
+    cmd.AddValue("logSink", "Logs: text (std::clog) or async (binary file written by a background thread, see log-format)", logSink);
+    cmd.AddValue("logFile", "Binary log file (async)", logFile);
+    cmd.AddValue("profile", "Profile the events by target function, the report is written to this file", profile);
+    cmd.AddValue("scheduler", "Event scheduler: map, heap, list, calendar or ladder", scheduler);
+    cmd.AddValue("packetPool", "Serve the packets, buffers, tags and events from thread-local slab pools", packetPool);
+    cmd.AddValue("poolStats", "Print the allocation counters of the run", poolStats);
+    cmd.AddValue("forkAt", "Warm the simulation up to this time, then fork one run per forkRates value (0 disables) [s]", forkAt);
+    cmd.AddValue("forkRates", "Comma-separated Internet link data rates of the forked runs (e.g. 2Mbps,5Mbps,10Mbps)", forkRates);
+    cmd.AddValue("replications", "Most independent replications, each on its own RNG run, reported as per-flow means with confidence intervals (1 disables)", replications);
+    cmd.AddValue("minReplications", "Replications before the precision is checked", minReplications);
+    cmd.AddValue("replicationPrecision", "Half-width of the 95% confidence interval of every flow metric, relative to its mean, ending the replications", replicationPrecision);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(replications > 1 && forkAt > 0, "Replications cannot be forked from a warm-up");
+
+    // Independent replications, from here on each process runs one of them
+    ReplicationRunner runner(minReplications, replications, replicationPrecision);
+    if (replications > 1)
+    {
+        if (!runner.Fork())
+        {
+            runner.Print(std::cout);
+            return 0;
+        }
+        std::string suffix = ".rep" + std::to_string(runner.GetReplication());
+        logFile += suffix;
+        if (!profile.empty())
+        {
+            profile += suffix;
+        }
+        // Every replication would write the same trace files, and interleave its text logs with
+        // those of the others, only the async log files get their own suffix
+        animation = false;
+        tracing = false;
+        if (logSink != "async")
+        {
+            verbose = false;
+        }
+    }
+
+    NS_ABORT_MSG_IF((packetPool || poolStats) && !PacketPool::IsAvailable(), "packetPool and poolStats need a build with PACKET_POOL_REPLACE_NEW defined");
+    PacketPool::Enable(packetPool);
+    SetSchedulerType(scheduler);
+    if (!profile.empty())
+    {
+        ProfilingSimulatorImpl::Enable(profile);
+    }
+
+    NS_ABORT_MSG_IF(animFormat != "xml" && animFormat != "binary" && animFormat != "none",
+                    "animFormat must be xml, binary or none");
+    NS_ABORT_MSG_IF(logSink != "text" && logSink != "async", "logSink must be text or async");
+    NS_ABORT_MSG_IF(forkAt > 0 && !profile.empty(), "The profile would be shared by the forked runs");
+
+    std::vector<std::string> rates;
+    std::istringstream rateList(forkRates);
+    for (std::string rate; std::getline(rateList, rate, ',');)
+    {
+        rates.push_back(rate);
+    }
+    if (rates.empty())
+    {
+        rates.push_back("5Mbps");
+    }
+
+    if (headless)
+    {
+        verbose = false;
+        animation = false;
+        tracing = false;
+    }
+    if (forkAt > 0)
+    {
+        // The trace files are opened before the fork, every forked run would write to them
+        animation = false;
+        tracing = false;
+    }
+    if (!animation)
+    {
+        animFormat = "none";
+    }
 
     if (verbose)
     {
@@ -26,6 +152,11 @@ int main(int argc, char *argv[]) {
         LogComponentEnable("PacketSink", LOG_LEVEL_INFO);
         LogComponentEnable("OnOffApplication", LOG_LEVEL_INFO);
     }
+    AsyncLog asyncLog;
+    if (verbose && logSink == "async")
+    {
+        asyncLog.Start(logFile);
+    }
 
     // Nodes
     NodeContainer internetNodes;
@@ -109,106 +240,188 @@ int main(int argc, char *argv[]) {
     sourceApps.Start(Seconds(2.0));
     sourceApps.Stop(Seconds(6.0));
 
-    // Routing
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    // Routing, reloaded from the cache when the topology did not change
+    RoutingCache routing;
+    routing.Populate(routingCache);
 
-    // Animation
-    if (animation)
-    {
-        AnimationInterface anim("TFE-topology-TCP.xml");
-        anim.EnablePacketMetadata(true);
-
-        anim.UpdateNodeDescription(internetNodes.Get(0), "Internet");
-        anim.UpdateNodeDescription(routerNodes.Get(0), "Router");
-        anim.UpdateNodeDescription(csma0Nodes.Get(0), "N1.1");
-        anim.UpdateNodeDescription(csma0Nodes.Get(1), "N1.2");
-        anim.UpdateNodeDescription(csma0Nodes.Get(2), "N1.3");
-        anim.UpdateNodeDescription(csma1Nodes.Get(0), "N2.1");
-        anim.UpdateNodeDescription(csma1Nodes.Get(1), "N2.2");
-        anim.UpdateNodeDescription(csma1Nodes.Get(2), "N2.3");
-        anim.UpdateNodeDescription(csma2Nodes.Get(0), "N3.1");
-        anim.UpdateNodeDescription(csma3Nodes.Get(0), "N0.1");
-        anim.UpdateNodeDescription(csma3Nodes.Get(1), "N0.2");
-        anim.UpdateNodeDescription(csma3Nodes.Get(2), "N0.3");
+    // Node positions, shared by both animation formats
+    if (animFormat != "none")
+    {
+        int spacing=13;
 
-        //update the size of the nodes with a loop
-        anim.UpdateNodeSize(internetNodes.Get(0), 2.0, 2.0);
-        anim.UpdateNodeSize(routerNodes.Get(0), 2.0, 2.0);
-        anim.UpdateNodeSize(csma2Nodes.Get(0), 2.0, 2.0);
+        //update the position of the nodes
+        AnimationInterface::SetConstantPosition(internetNodes.Get(0), 43.5, 85.5);
+        AnimationInterface::SetConstantPosition(routerNodes.Get(0), 43.5, 73);
 
         for(uint32_t i = 0; i < csma0Nodes.GetN(); i++)
         {
-            anim.UpdateNodeSize(csma0Nodes.Get(i), 2.0, 2.0);
+            AnimationInterface::SetConstantPosition(csma0Nodes.Get(i) , 70.0, 63 - spacing*i);
         }
 
         for(uint32_t i = 0; i < csma1Nodes.GetN(); i++)
         {
-            anim.UpdateNodeSize(csma1Nodes.Get(i), 2.0, 2.0);
+            AnimationInterface::SetConstantPosition(csma1Nodes.Get(i), 43.5 - spacing*i, 63);
+        }
+
+        for(uint32_t i = 0; i < csma2Nodes.GetN(); i++)
+        {
+            AnimationInterface::SetConstantPosition(csma2Nodes.Get(i), 17.5, 63 - spacing*i);
         }
 
         for(uint32_t i = 0; i < csma3Nodes.GetN(); i++)
         {
-            anim.UpdateNodeSize(csma3Nodes.Get(i), 2.0, 2.0);
+            AnimationInterface::SetConstantPosition(csma3Nodes.Get(i), 43.5 - spacing*i, 18.0);
         }
+    }
 
+    // Animation
+    // Kept until the end of the simulation, the trace is written while it runs
+    std::unique_ptr<AnimationInterface> anim;
+    std::unique_ptr<CompactAnimation> compactAnim;
+    if (animFormat == "xml")
+    {
+        anim = std::make_unique<AnimationInterface>("TFE-topology-TCP.xml");
+        anim->EnablePacketMetadata(true);
+
+        anim->UpdateNodeDescription(internetNodes.Get(0), "Internet");
+        anim->UpdateNodeDescription(routerNodes.Get(0), "Router");
+        anim->UpdateNodeDescription(csma0Nodes.Get(0), "N1.1");
+        anim->UpdateNodeDescription(csma0Nodes.Get(1), "N1.2");
+        anim->UpdateNodeDescription(csma0Nodes.Get(2), "N1.3");
+        anim->UpdateNodeDescription(csma1Nodes.Get(0), "N2.1");
+        anim->UpdateNodeDescription(csma1Nodes.Get(1), "N2.2");
+        anim->UpdateNodeDescription(csma1Nodes.Get(2), "N2.3");
+        anim->UpdateNodeDescription(csma2Nodes.Get(0), "N3.1");
+        anim->UpdateNodeDescription(csma3Nodes.Get(0), "N0.1");
+        anim->UpdateNodeDescription(csma3Nodes.Get(1), "N0.2");
+        anim->UpdateNodeDescription(csma3Nodes.Get(2), "N0.3");
 
-        //update the color of the nodes with a loop
-        anim.UpdateNodeColor(internetNodes.Get(0), 255, 0, 0);
-        anim.UpdateNodeColor(routerNodes.Get(0), 255, 0, 0);
-        anim.UpdateNodeColor(csma2Nodes.Get(0), 0, 255, 0);
+        //update the size of the nodes with a loop
+        anim->UpdateNodeSize(internetNodes.Get(0), 2.0, 2.0);
+        anim->UpdateNodeSize(routerNodes.Get(0), 2.0, 2.0);
+        anim->UpdateNodeSize(csma2Nodes.Get(0), 2.0, 2.0);
 
         for(uint32_t i = 0; i < csma0Nodes.GetN(); i++)
         {
-            anim.UpdateNodeColor(csma0Nodes.Get(i), 0, 255, 0);
+            anim->UpdateNodeSize(csma0Nodes.Get(i), 2.0, 2.0);
         }
 
         for(uint32_t i = 0; i < csma1Nodes.GetN(); i++)
         {
-            anim.UpdateNodeColor(csma1Nodes.Get(i), 0, 0, 255);
+            anim->UpdateNodeSize(csma1Nodes.Get(i), 2.0, 2.0);
         }
 
         for(uint32_t i = 0; i < csma3Nodes.GetN(); i++)
         {
-            anim.UpdateNodeColor(csma3Nodes.Get(i), 255, 255, 0);
+            anim->UpdateNodeSize(csma3Nodes.Get(i), 2.0, 2.0);
         }
-        
-        int spacing=13;
 
-        //update the position of the nodes
-        anim.SetConstantPosition(internetNodes.Get(0), 43.5, 85.5);
-        anim.SetConstantPosition(routerNodes.Get(0), 43.5, 73);
+
+        //update the color of the nodes with a loop
+        anim->UpdateNodeColor(internetNodes.Get(0), 255, 0, 0);
+        anim->UpdateNodeColor(routerNodes.Get(0), 255, 0, 0);
+        anim->UpdateNodeColor(csma2Nodes.Get(0), 0, 255, 0);
 
         for(uint32_t i = 0; i < csma0Nodes.GetN(); i++)
         {
-            anim.SetConstantPosition(csma0Nodes.Get(i) , 70.0, 63 - spacing*i);
+            anim->UpdateNodeColor(csma0Nodes.Get(i), 0, 255, 0);
         }
 
         for(uint32_t i = 0; i < csma1Nodes.GetN(); i++)
         {
-            anim.SetConstantPosition(csma1Nodes.Get(i), 43.5 - spacing*i, 63);
-        }
-
-        for(uint32_t i = 0; i < csma2Nodes.GetN(); i++)
-        {
-            anim.SetConstantPosition(csma2Nodes.Get(i), 17.5, 63 - spacing*i);
+            anim->UpdateNodeColor(csma1Nodes.Get(i), 0, 0, 255);
         }
 
         for(uint32_t i = 0; i < csma3Nodes.GetN(); i++)
         {
-            anim.SetConstantPosition(csma3Nodes.Get(i), 43.5 - spacing*i, 18.0);
+            anim->UpdateNodeColor(csma3Nodes.Get(i), 255, 255, 0);
         }
     }
+    else if (animFormat == "binary")
+    {
+        // Sampled binary animation, converted to NetAnim XML offline by anim-convert
+        compactAnim = std::make_unique<CompactAnimation>("TFE-topology-TCP.nsa");
+        compactAnim->SetSampling(animSample, animPerFlow);
+        compactAnim->SetWindow(Seconds(animStart), Seconds(animStop));
+        compactAnim->UpdateNodeDescription(internetNodes.Get(0), "Internet");
+        compactAnim->UpdateNodeDescription(routerNodes.Get(0), "Router");
+        compactAnim->Install();
+    }
     
 
     // Enable packet capture
-    p2p.EnablePcapAll("TFE-topology-TCP");
-    //csma.EnablePcap("TCP-lan0", csma0Devices);
-    //csma.EnablePcap("TCP-lan1", csma1Devices);
-    csma.EnablePcap("TCP-lan2", csma2Devices);
-    //csma.EnablePcap("TCP-lan3", csma3Devices);
-
-    // Simulation
-    Simulator::Run();
+    if (tracing)
+    {
+        p2p.EnablePcapAll("TFE-topology-TCP");
+        //csma.EnablePcap("TCP-lan0", csma0Devices);
+        //csma.EnablePcap("TCP-lan1", csma1Devices);
+        csma.EnablePcap("TCP-lan2", csma2Devices);
+        //csma.EnablePcap("TCP-lan3", csma3Devices);
+    }
+
+    // Per-flow metrics of the replications
+    FlowMonitorHelper flowmon;
+    if (runner.IsReplication())
+    {
+        flowmon.InstallAll();
+    }
+
+    // Simulation, from the start or from the fork to the end
+    auto runToEnd = [&](const std::string &arguments)
+    {
+        perf.Start();
+        Simulator::Run();
+        perf.Stop();
+        std::vector<std::string> names;
+        std::vector<double> values;
+        if (runner.IsReplication())
+        {
+            CollectFlowMetrics(flowmon, names, values);
+        }
+        if (!perfReport.empty())
+        {
+            perf.Write(perfReport, "TFE-topology-TCP", arguments);
+        }
+        asyncLog.Stop();
+        Simulator::Destroy();
+        if (poolStats)
+        {
+            PacketPool::PrintStats(std::cout);
+        }
+        // Exits in a replication
+        runner.Submit(names, values);
+    };
+    if (forkAt == 0)
+    {
+        runToEnd(PerfReport::GetArguments(argc, argv));
+        return 0;
+    }
+
+    // The handshake and slow start are simulated once, each forked run then continues with its
+    // own Internet link data rate. The log thread runs during the warm-up and is stopped right
+    // before the forks
+    Ptr<PacketSink> sink = DynamicCast<PacketSink>(sinkApps.Get(0));
+    WarmFork warmFork;
+    uint32_t failed = warmFork.Run(Seconds(forkAt), rates.size(), [&](uint32_t child)
+    {
+        WarmFork::Reseed(child);
+        stack.AssignStreams(NodeContainer::GetGlobal(), 0);
+        internetDevices.Get(0)->SetAttribute("DataRate", StringValue(rates[child]));
+        internetDevices.Get(1)->SetAttribute("DataRate", StringValue(rates[child]));
+        if (verbose && logSink == "async")
+        {
+            asyncLog.Start(logFile + ".fork" + std::to_string(child));
+        }
+        uint64_t warmBytes = sink->GetTotalRx();
+        runToEnd(PerfReport::GetArguments(argc, argv) + " forkRate=" + rates[child]);
+        std::cout << "Fork " << child << " (" << rates[child] << "): " << sink->GetTotalRx() - warmBytes
+                  << " bytes received after " << forkAt << "s" << std::endl;
+    },
+    [&asyncLog]()
+    {
+        asyncLog.Stop();
+    });
+    NS_ABORT_MSG_IF(failed > 0, failed << " forked runs failed");
     Simulator::Destroy();
 
     return 0;
@@ -1,4 +1,5 @@
 #include "ns3/applications-module.h"
+#include "ns3/bridge-module.h"
 #include "ns3/core-module.h"
 #include "ns3/csma-module.h"
 #include "ns3/internet-module.h"
@@ -7,24 +8,199 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/animation-interface.h"
 #include "ns3/flow-monitor-module.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
+
+#include "compact-animation.h"
+#include "event-profiler.h"
+#include "flow-metrics.h"
+#include "ladder-scheduler.h"
+#include "replication-runner.h"
+#include "route-tracker.h"
+#include "routing-cache.h"
+#include "sim-perf.h"
+
+#include <memory>
 
 using namespace ns3;
 
+/**
+ * Installe un LAN CSMA sur les noeuds donnés.
+ *
+ * En mode partagé, tous les noeuds sont sur un même canal et chaque trame est
+ * remise à tous les dispositifs du LAN. En mode commuté, chaque noeud a son
+ * propre lien CSMA vers un switch (BridgeNetDevice) : une fois les adresses
+ * apprises, une trame unicast n'est remise qu'au port du destinataire, et
+ * seules les trames broadcast/multicast sont diffusées sur tous les ports.
+ *
+ * \param csma Caractéristiques des liens du LAN.
+ * \param nodes Noeuds du LAN.
+ * \param switched Vrai pour le mode commuté.
+ * \return Les dispositifs des noeuds, dans l'ordre des noeuds.
+ */
+NetDeviceContainer
+InstallLan(CsmaHelper& csma, NodeContainer nodes, bool switched)
+{
+    if(!switched)
+    {
+        return csma.Install(nodes);
+    }
+
+    //Le switch n'a pas de pile IP
+    Ptr<Node> switchNode = CreateObject<Node>();
+    NetDeviceContainer devices;
+    NetDeviceContainer switchDevices;
+    for(uint32_t i = 0; i < nodes.GetN(); i++)
+    {
+        NetDeviceContainer link = csma.Install(NodeContainer(nodes.Get(i), switchNode));
+        devices.Add(link.Get(0));
+        switchDevices.Add(link.Get(1));
+    }
+    BridgeHelper bridge;
+    bridge.Install(switchNode, switchDevices);
+    return devices;
+}
+
 int
 main(int argc, char* argv[])
 {
-
+    PerfReport perf;
     bool verbose = true;
     uint32_t nCsma = 4;
     bool tracing = false;
+    bool headless = false;
+    std::string perfReport = "";
+    std::string lanMode = "shared";
+    std::string routingCache = "";
+    double linkDown = 0;
+    double linkUp = 0;
+    bool checkRoutes = false;
+    std::string animFormat = "xml";
+    uint32_t animSample = 1;
+    bool animPerFlow = false;
+    double animStart = 0;
+    double animStop = 0;
+    std::string routeTracking = "events";
+    std::string profile = "";
+    std::string scheduler = "map";
+    uint32_t replications = 1;
+    uint32_t minReplications = 3;
+    double replicationPrecision = 0.05;
+#ifdef NS3_MPI
+    bool mpi = false;
+    bool nullmsg = false;
+#endif
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
     cmd.AddValue("verbose", "Tell echo applications to log if true", verbose);
     cmd.AddValue("tracing", "Enable pcap tracing", tracing);
+    cmd.AddValue("headless", "Disable logging, packet capture and animation", headless);
+    cmd.AddValue("perfReport", "Append a performance report of the run to this file", perfReport);
+    cmd.AddValue("lanMode", "CSMA LANs: shared (one channel) or switched (one link per node to a switch)", lanMode);
+    cmd.AddValue("routingCache", "Load the routing tables from this file, or save them there if the topology changed", routingCache);
+    cmd.AddValue("linkDown", "Time the LAN 3 router interface goes down, 0 to keep it up [s]", linkDown);
+    cmd.AddValue("linkUp", "Time the LAN 3 router interface comes back up, 0 to leave it down [s]", linkUp);
+    cmd.AddValue("checkRoutes", "Abort if the routes updated at linkDown differ from a full SPF", checkRoutes);
+    cmd.AddValue("animFormat", "Animation: xml (NetAnim), binary (compact, see anim-convert) or none", animFormat);
+    cmd.AddValue("animSample", "Binary animation: record 1 packet in animSample", animSample);
+    cmd.AddValue("animPerFlow", "Binary animation: sample 1 flow in animSample instead of packets", animPerFlow);
+    cmd.AddValue("animStart", "Binary animation: start of the recording [s]", animStart);
+    cmd.AddValue("animStop", "Binary animation: end of the recording, 0 until the end [s]", animStop);
+    cmd.AddValue("routeTracking", "Routing table changes: events (when routes are computed), poll (every second), xml (NetAnim full dumps, needs animFormat=xml) or none", routeTracking);
+    cmd.AddValue("profile", "Profile the events by target function, the report is written to this file", profile);
+    cmd.AddValue("scheduler", "Event scheduler: map, heap, list, calendar or ladder", scheduler);
+    cmd.AddValue("replications", "Most independent replications, each on its own RNG run, reported as per-flow means with confidence intervals (1 disables)", replications);
+    cmd.AddValue("minReplications", "Replications before the precision is checked", minReplications);
+    cmd.AddValue("replicationPrecision", "Half-width of the 95% confidence interval of every flow metric, relative to its mean, ending the replications", replicationPrecision);
+#ifdef NS3_MPI
+    cmd.AddValue("mpi", "Run distributed on 2 MPI ranks, the internet node on rank 1", mpi);
+    cmd.AddValue("nullmsg", "Use the null message distributed scheduler", nullmsg);
+#endif
 
     cmd.Parse(argc, argv);
 
+    //Réplications indépendantes : à partir d'ici, chaque processus en exécute une
+#ifdef NS3_MPI
+    NS_ABORT_MSG_IF(mpi && replications > 1, "Les réplications ne sont pas possibles en simulation distribuée");
+#endif
+    ReplicationRunner runner(minReplications, replications, replicationPrecision);
+    if(replications > 1)
+    {
+        if(!runner.Fork())
+        {
+            runner.Print(std::cout);
+            return 0;
+        }
+        if(!profile.empty())
+        {
+            profile += ".rep" + std::to_string(runner.GetReplication());
+        }
+        //Chaque réplication écrirait les mêmes fichiers de trace et mêlerait ses logs à ceux des autres
+        headless = true;
+    }
+
+    //Ordonnanceur d'événements et profilage, à choisir avant toute utilisation du simulateur
+    SetSchedulerType(scheduler);
+    if(!profile.empty())
+    {
+#ifdef NS3_MPI
+        NS_ABORT_MSG_IF(mpi, "Le profilage n'est pas possible en simulation distribuée");
+#endif
+        ProfilingSimulatorImpl::Enable(profile);
+    }
+
+    //Simulation distribuée : le noeud internet est sur le rang 1, les LAN et les routeurs sur
+    //le rang 0. Seuls des liens point à point peuvent relier deux rangs, le lien de 2 ms vers
+    //internet est la seule frontière possible : les LAN partagent leurs routeurs.
+    uint32_t systemId = 0;
+    uint32_t systemCount = 1;
+#ifdef NS3_MPI
+    if(mpi)
+    {
+        if(nullmsg)
+        {
+            GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::NullMessageSimulatorImpl"));
+        }
+        else
+        {
+            GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DistributedSimulatorImpl"));
+        }
+        MpiInterface::Enable(&argc, &argv);
+        systemId = MpiInterface::GetSystemId();
+        systemCount = MpiInterface::GetSize();
+        NS_ABORT_MSG_IF(systemCount != 2, "La simulation distribuée utilise exactement 2 rangs");
+    }
+#endif
+    bool distributed = systemCount > 1;
+
+    NS_ABORT_MSG_IF(lanMode != "shared" && lanMode != "switched", "lanMode doit valoir shared ou switched");
+    bool switched = lanMode == "switched";
+    NS_ABORT_MSG_IF(animFormat != "xml" && animFormat != "binary" && animFormat != "none", "animFormat doit valoir xml, binary ou none");
+    NS_ABORT_MSG_IF(routeTracking != "events" && routeTracking != "poll" && routeTracking != "xml" && routeTracking != "none", "routeTracking doit valoir events, poll, xml ou none");
+
+    //Tous les rangs ont les mêmes routes, le premier les suit
+    if(systemId != 0)
+    {
+        routeTracking = "none";
+    }
+
+    //L'animation a besoin de tous les noeuds sur un seul rang
+    if(distributed)
+    {
+        animFormat = "none";
+    }
+
+    //Mode sans sortie, pour mesurer la vitesse de la simulation
+    if(headless)
+    {
+        verbose = false;
+        tracing = false;
+        animFormat = "none";
+        routeTracking = "none";
+    }
+
     //Activation des logs
     if(verbose)
     {
@@ -47,8 +223,9 @@ main(int argc, char* argv[])
     //Création de deux noeuds point à point
     NodeContainer p2pNodes;
 
-    //création des noeuds
-    p2pNodes.Create(2);
+    //création des noeuds, le noeud internet en premier
+    p2pNodes.Create(1, distributed ? 1 : 0);
+    p2pNodes.Create(1);
     csmaNodes0.Create(nCsma);
     csmaNodes1.Create(nCsma);
     csmaNodes2.Create(nCsma);
@@ -89,16 +266,16 @@ main(int argc, char* argv[])
 
     //Installation des dispositifs CSMA
     NetDeviceContainer csmaDevices0;
-    csmaDevices0 = csma0.Install(csmaNodes0);
+    csmaDevices0 = InstallLan(csma0, csmaNodes0, switched);
  
     NetDeviceContainer csmaDevices1;
-    csmaDevices1 = csma1.Install(csmaNodes1);
+    csmaDevices1 = InstallLan(csma1, csmaNodes1, switched);
 
     NetDeviceContainer csmaDevices2;
-    csmaDevices2 = csma2.Install(csmaNodes2);
+    csmaDevices2 = InstallLan(csma2, csmaNodes2, switched);
 
     NetDeviceContainer csmaDevices3;
-    csmaDevices3 = csma3.Install(csmaNodes3);
+    csmaDevices3 = InstallLan(csma3, csmaNodes3, switched);
 
     //caractéristiques du lien point à point
     PointToPointHelper pointToPoint;
@@ -152,101 +329,211 @@ main(int argc, char* argv[])
     lan3interfaces = address.Assign(csmaDevices3);
 
 
-    //Creation du serveur et du client UDP
-    UdpEchoServerHelper echoServer(13);
-    ApplicationContainer serverApps = echoServer.Install(csmaNodes3.Get(0));
-    serverApps.Start(Seconds(0));
-    serverApps.Stop(Seconds(10.0));
+    //Creation du serveur et du client UDP, chacun par le rang de son noeud
+    if(csmaNodes3.Get(0)->GetSystemId() == systemId)
+    {
+        UdpEchoServerHelper echoServer(13);
+        ApplicationContainer serverApps = echoServer.Install(csmaNodes3.Get(0));
+        serverApps.Start(Seconds(0));
+        serverApps.Stop(Seconds(10.0));
+    }
 
     //creation du client
-    UdpEchoClientHelper echoClient(lan3interfaces.GetAddress(0), 13);
-    echoClient.SetAttribute("MaxPackets", UintegerValue(100));
-    echoClient.SetAttribute("Interval", TimeValue(MilliSeconds(200)));
-    echoClient.SetAttribute("PacketSize", UintegerValue(1024));
+    if(p2pNodes.Get(0)->GetSystemId() == systemId)
+    {
+        UdpEchoClientHelper echoClient(lan3interfaces.GetAddress(0), 13);
+        echoClient.SetAttribute("MaxPackets", UintegerValue(100));
+        echoClient.SetAttribute("Interval", TimeValue(MilliSeconds(200)));
+        echoClient.SetAttribute("PacketSize", UintegerValue(1024));
 
-    NodeContainer clientNodes(p2pNodes.Get(0));
+        NodeContainer clientNodes(p2pNodes.Get(0));
 
-    ApplicationContainer clientApps = echoClient.Install(clientNodes);
-    clientApps.Start(Seconds(1));
-    clientApps.Stop(Seconds(10));
+        ApplicationContainer clientApps = echoClient.Install(clientNodes);
+        clientApps.Start(Seconds(1));
+        clientApps.Stop(Seconds(10));
+    }
 
 
-    //Activation du routage
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    //Activation du routage, depuis le cache si la topologie n'a pas changé
+    //En mode distribué chaque rang a son propre fichier de cache
+    RoutingCache routing;
+    routing.SetCheckFullSpf(checkRoutes);
+    if(!routingCache.empty() && distributed)
+    {
+        routingCache += ".rank" + std::to_string(systemId);
+    }
+
+    //Suivi des tables de routage : seules les routes ajoutées, retirées ou modifiées sont écrites,
+    //le premier calcul des routes donne l'état complet au départ
+    std::unique_ptr<RouteTracker> routeTracker;
+    if(routeTracking == "events" || routeTracking == "poll")
+    {
+        routeTracker = std::make_unique<RouteTracker>("routingtable-topology.txt");
+    }
+    if(routeTracking == "events")
+    {
+        routing.AddRoutesChangedCallback(MakeCallback(&RouteTracker::Track, routeTracker.get()));
+    }
+    else if(routeTracking == "poll")
+    {
+        routeTracker->Poll(Seconds(1), Seconds(10), Seconds(1));
+    }
+    routing.Populate(routingCache);
+
+    //Coupure du lien entre le routeur et le LAN 3, seules les routes qui l'empruntaient sont recalculées
+    Ptr<Node> lan3Router = csmaNodes3.Get(1);
+    uint32_t lan3Interface = lan3Router->GetObject<Ipv4>()->GetInterfaceForDevice(csmaDevices3.Get(1));
+    if(linkDown > 0)
+    {
+        Simulator::Schedule(Seconds(linkDown), &RoutingCache::SetInterfaceState, &routing, lan3Router, lan3Interface, false);
+    }
+    if(linkUp > 0)
+    {
+        Simulator::Schedule(Seconds(linkUp), &RoutingCache::SetInterfaceState, &routing, lan3Router, lan3Interface, true);
+    }
 
     //Activation de la capture de paquets sur tous les noeuds reliés à deux réseaux en spécifiant le nom du fichier de capture
 
+    //En mode distribué, chaque rang ne capture que les dispositifs de ses noeuds
     if(tracing)
     {
-        pointToPoint.EnablePcapAll("TFE-topology-UDP");
-        csma0.EnablePcap("lan0", csmaDevices0);
-        csma1.EnablePcap("lan1", csmaDevices1);
-        csma2.EnablePcap("lan2", csmaDevices2);
-        csma3.EnablePcap("lan3", csmaDevices3);
-        pointToPoint.EnableAscii("TFE-topology-UDP", p2pNodes);
+        for(uint32_t i = 0; i < p2pDevices.GetN(); i++)
+        {
+            if(p2pDevices.Get(i)->GetNode()->GetSystemId() == systemId)
+            {
+                pointToPoint.EnablePcap("TFE-topology-UDP", p2pDevices.Get(i));
+                pointToPoint.EnableAscii("TFE-topology-UDP", p2pDevices.Get(i));
+            }
+        }
+        if(systemId == 0)
+        {
+            csma0.EnablePcap("lan0", csmaDevices0);
+            csma1.EnablePcap("lan1", csmaDevices1);
+            csma2.EnablePcap("lan2", csmaDevices2);
+            csma3.EnablePcap("lan3", csmaDevices3);
+        }
+    }
+    //Capture de tous les dispositifs CSMA, quel que soit le format d'animation
+    if(!headless && systemId == 0)
+    {
+        csma3.EnablePcapAll("TFE-topology-UDP-csma3");
     }
 
 
 
-    //Configure la position des noeuds dans une animation
-    AnimationInterface anim("TFE-topology-UDP.xml");
-    anim.EnablePacketMetadata(true);
-    anim.EnableIpv4RouteTracking("routingtable-topology.xml", Seconds(1), Seconds(10), Seconds(1));
-    //anim.AddNodeCounter(RouterNodes, "Router");
-    
-    anim.UpdateNodeDescription(RouterNodes.Get(0), "Routeur 0");
-    anim.UpdateNodeDescription(RouterNodes.Get(1), "Routeur 1");
-    anim.UpdateNodeDescription(RouterNodes.Get(2), "Routeur 2");
-    anim.UpdateNodeDescription(RouterNodes.Get(3), "Routeur 3");
-    anim.SetConstantPosition(p2pNodes.Get(0), 43.5, 85.5);
-    anim.SetConstantPosition(p2pNodes.Get(1), 43.5, 73);
-    csma3.EnablePcapAll("TFE-topology-UDP-csma3");
+    //Position des noeuds, commune aux deux formats d'animation
+    if(animFormat != "none")
+    {
+        AnimationInterface::SetConstantPosition(p2pNodes.Get(0), 43.5, 85.5);
+        AnimationInterface::SetConstantPosition(p2pNodes.Get(1), 43.5, 73);
 
-    int nodeSize = 3;
-    //Taille des noeuds
-    anim.UpdateNodeSize(p2pNodes.Get(0), nodeSize, nodeSize);
-    anim.UpdateNodeSize(p2pNodes.Get(1), nodeSize, nodeSize);
-    anim.UpdateNodeSize(csmaNodes3.Get(0), nodeSize, nodeSize);
+        int center=53.5;
+        int spacing=13;
 
-    for(uint32_t i = 0; i < nCsma; i++)
-    {
-        anim.UpdateNodeSize(csmaNodes0.Get(i), nodeSize, nodeSize);
-        anim.UpdateNodeColor(csmaNodes0.Get(i), 255, 0, 0);
-        anim.UpdateNodeSize(csmaNodes1.Get(i), nodeSize, nodeSize);
-        anim.UpdateNodeColor(csmaNodes1.Get(i), 0, 255, 0);
-        anim.UpdateNodeSize(csmaNodes2.Get(i), nodeSize, nodeSize);
-        anim.UpdateNodeColor(csmaNodes2.Get(i), 0, 0, 255);
-    }
+        //Positionnement des noeuds du LAN 0 à la verticale à gauche
+        for(uint32_t i = 0; i < nCsma; i++)
+        {
+            AnimationInterface::SetConstantPosition(csmaNodes0.Get(i), center - spacing*i, 63);
+        }
 
+        //Positionnement des noeuds du LAN 2 à la verticale à droite des noeuds du LAN 0
 
-    int center=53.5;
-    int spacing=13;
+        for(uint32_t i = 0; i < nCsma; i++)
+        {
+            AnimationInterface::SetConstantPosition(csmaNodes2.Get(i) , 70.0, 63 - spacing*i);
+        }
 
-    //Positionnement des noeuds du LAN 0 à la verticale à gauche
-    for(uint32_t i = 0; i < nCsma; i++)
-    {
-        anim.SetConstantPosition(csmaNodes0.Get(i), center - spacing*i, 63);
-    }
+        //Positionnement des noeuds du LAN 1 à l'horizontale au dessus des noeuds du LAN 0 et à gauche des noeuds du LAN 2
 
-    //Positionnement des noeuds du LAN 2 à la verticale à droite des noeuds du LAN 0
+        for(uint32_t i = 0; i < nCsma; i++)
+        {
+            AnimationInterface::SetConstantPosition(csmaNodes1.Get(i), center - spacing*i, 18.0);
+        }
 
-    for(uint32_t i = 0; i < nCsma; i++)
-    {
-        anim.SetConstantPosition(csmaNodes2.Get(i) , 70.0, 63 - spacing*i);
+        //Positionnement des noeuds du LAN 3 à l'horizontale en dessous des noeuds du LAN 0
+        AnimationInterface::SetConstantPosition(csmaNodes3.Get(0), 33.5, 47.0);
     }
 
-    //Positionnement des noeuds du LAN 1 à l'horizontale au dessus des noeuds du LAN 0 et à gauche des noeuds du LAN 2
-    
-    for(uint32_t i = 0; i < nCsma; i++)
+    std::unique_ptr<AnimationInterface> anim;
+    std::unique_ptr<CompactAnimation> compactAnim;
+    if(animFormat == "xml")
+    {
+        anim = std::make_unique<AnimationInterface>("TFE-topology-UDP.xml");
+        anim->EnablePacketMetadata(true);
+        if(routeTracking == "xml")
+        {
+            anim->EnableIpv4RouteTracking("routingtable-topology.xml", Seconds(1), Seconds(10), Seconds(1));
+        }
+        //anim->AddNodeCounter(RouterNodes, "Router");
+
+        anim->UpdateNodeDescription(RouterNodes.Get(0), "Routeur 0");
+        anim->UpdateNodeDescription(RouterNodes.Get(1), "Routeur 1");
+        anim->UpdateNodeDescription(RouterNodes.Get(2), "Routeur 2");
+        anim->UpdateNodeDescription(RouterNodes.Get(3), "Routeur 3");
+
+        int nodeSize = 3;
+        //Taille des noeuds
+        anim->UpdateNodeSize(p2pNodes.Get(0), nodeSize, nodeSize);
+        anim->UpdateNodeSize(p2pNodes.Get(1), nodeSize, nodeSize);
+        anim->UpdateNodeSize(csmaNodes3.Get(0), nodeSize, nodeSize);
+
+        for(uint32_t i = 0; i < nCsma; i++)
+        {
+            anim->UpdateNodeSize(csmaNodes0.Get(i), nodeSize, nodeSize);
+            anim->UpdateNodeColor(csmaNodes0.Get(i), 255, 0, 0);
+            anim->UpdateNodeSize(csmaNodes1.Get(i), nodeSize, nodeSize);
+            anim->UpdateNodeColor(csmaNodes1.Get(i), 0, 255, 0);
+            anim->UpdateNodeSize(csmaNodes2.Get(i), nodeSize, nodeSize);
+            anim->UpdateNodeColor(csmaNodes2.Get(i), 0, 0, 255);
+        }
+    }
+    else if(animFormat == "binary")
     {
-        anim.SetConstantPosition(csmaNodes1.Get(i), center - spacing*i, 18.0);
+        //Animation binaire échantillonnée, convertie en XML après coup par anim-convert
+        compactAnim = std::make_unique<CompactAnimation>("TFE-topology-UDP.nsa");
+        compactAnim->SetSampling(animSample, animPerFlow);
+        compactAnim->SetWindow(Seconds(animStart), Seconds(animStop));
+        compactAnim->UpdateNodeDescription(RouterNodes.Get(0), "Routeur 0");
+        compactAnim->UpdateNodeDescription(RouterNodes.Get(1), "Routeur 1");
+        compactAnim->UpdateNodeDescription(RouterNodes.Get(2), "Routeur 2");
+        compactAnim->UpdateNodeDescription(RouterNodes.Get(3), "Routeur 3");
+        compactAnim->Install();
     }
 
-    //Positionnement des noeuds du LAN 3 à l'horizontale en dessous des noeuds du LAN 0
-    anim.SetConstantPosition(csmaNodes3.Get(0), 33.5, 47.0);
+    //Métriques par flux des réplications
+    FlowMonitorHelper flowmon;
+    if(runner.IsReplication())
+    {
+        flowmon.InstallAll();
+    }
 
     //Lancement de la simulation
+    perf.Start();
     Simulator::Run();
+    perf.Stop();
+    std::vector<std::string> names;
+    std::vector<double> values;
+    if(runner.IsReplication())
+    {
+        CollectFlowMetrics(flowmon, names, values);
+    }
+    if(!perfReport.empty())
+    {
+        std::string parameters = PerfReport::GetArguments(argc, argv);
+        if(distributed)
+        {
+            parameters += " rank=" + std::to_string(systemId);
+        }
+        perf.Write(perfReport, "TFE-topology-UDP", parameters);
+    }
     Simulator::Destroy();
+#ifdef NS3_MPI
+    if(mpi)
+    {
+        MpiInterface::Disable();
+    }
+#endif
+    //Termine le processus d'une réplication
+    runner.Submit(names, values);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "ns3/command-line.h"
+
+#include "compact-animation.h"
+
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+using namespace ns3;
+
+/*
+ * Convert an animation file written by CompactAnimation (e.g.
+ * TFE-topology-UDP.nsa, with --animFormat=binary) to a NetAnim XML trace.
+ *
+ *   ./ns3 run "anim-convert --input=TFE-topology-UDP.nsa --output=TFE-topology-UDP.xml"
+ *
+ * Each reception is paired with the last transmission of the same packet, which
+ * is the previous hop since the wired devices store and forward.
+ */
+
+/// Last transmission of a packet
+struct Transmission
+{
+    uint32_t node;   ///< Transmitting node
+    int64_t beginNs; ///< First bit transmitted [ns]
+    int64_t endNs;   ///< Last bit transmitted [ns], -1 while in progress
+};
+
+int main(int argc, char *argv[])
+{
+    std::string input = "";
+    std::string output = "";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "Animation file to convert", input);
+    cmd.AddValue("output", "NetAnim XML file (stdout when empty)", output);
+    cmd.Parse(argc, argv);
+
+    CompactAnimationReader reader;
+    if (!reader.Open(input))
+    {
+        std::cerr << "Cannot read animation file " << input << std::endl;
+        return 1;
+    }
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+    }
+    std::ostream &out = output.empty() ? std::cout : file;
+    out.precision(12);
+    out << "<anim ver=\"netanim-3.108\" filetype=\"animation\" >\n";
+
+    // The topology comes first in NetAnim traces, the node blocks are read in a first pass
+    std::vector<AnimNode> nodes;
+    std::vector<AnimEvent> events;
+    while (reader.ReadBlock(nodes, events))
+    {
+        for (const auto &node : nodes)
+        {
+            out << "<node id=\"" << node.id << "\" sysId=\"0\" locX=\"" << node.x
+                << "\" locY=\"" << node.y << "\" />\n";
+            if (!node.description.empty())
+            {
+                out << "<nu p=\"d\" t=\"0\" id=\"" << node.id << "\" descr=\""
+                    << node.description << "\" />\n";
+            }
+        }
+    }
+
+    reader.Rewind();
+    std::unordered_map<uint64_t, Transmission> transmissions;
+    uint64_t nPackets = 0;
+    while (reader.ReadBlock(nodes, events))
+    {
+        for (const auto &event : events)
+        {
+            if (event.kind == AnimEvent::TX_BEGIN)
+            {
+                transmissions[event.uid] = {event.node, event.timeNs, -1};
+                continue;
+            }
+            auto transmission = transmissions.find(event.uid);
+            if (transmission == transmissions.end())
+            {
+                continue;
+            }
+            if (event.kind == AnimEvent::TX_END)
+            {
+                transmission->second.endNs = event.timeNs;
+                continue;
+            }
+            // A reception without its transmission end started before the time window
+            const Transmission &tx = transmission->second;
+            if (tx.endNs < 0)
+            {
+                continue;
+            }
+            int64_t firstBitRxNs = event.timeNs - (tx.endNs - tx.beginNs);
+            out << "<p fId=\"" << tx.node << "\" fbTx=\"" << tx.beginNs * 1e-9 << "\" lbTx=\""
+                << tx.endNs * 1e-9 << "\" tId=\"" << event.node << "\" fbRx=\""
+                << firstBitRxNs * 1e-9 << "\" lbRx=\"" << event.timeNs * 1e-9 << "\" />\n";
+            nPackets++;
+        }
+        // Packets whose transmission ended a second ago have been received everywhere
+        if (!events.empty())
+        {
+            int64_t horizonNs = events.back().timeNs - 1000000000;
+            for (auto it = transmissions.begin(); it != transmissions.end();)
+            {
+                it = it->second.endNs >= 0 && it->second.endNs < horizonNs
+                         ? transmissions.erase(it)
+                         : std::next(it);
+            }
+        }
+    }
+    out << "</anim>\n";
+    std::cerr << nPackets << " packet hops converted" << std::endl;
+    return 0;
+}
@@ -0,0 +1,469 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/*
+ * Log file layout, in host byte order:
+ *
+ *   "NSLG" | uint32 version
+ *   then any number of records, each starting with a type byte:
+ *   'F' | uint32 formatId | uint32 length | format
+ *   'R' | int64 time [ns] | uint32 context | uint32 formatId | uint8 nArgs |
+ *         nArgs x (uint8 length, argument)
+ *
+ * A format is a log line with its numbers replaced by logArgMarker, the
+ * numbers are the arguments of the record. A format is always defined before
+ * the first record using it.
+ */
+
+/// Magic number at the start of a log file
+static const char logMagic[4] = {'N', 'S', 'L', 'G'};
+/// Version of the log file layout
+static const uint32_t logVersion = 1;
+/// Stands for an argument in a log format
+static const char logArgMarker = '\x1f';
+
+/**
+ * \brief Asynchronous binary sink for the NS_LOG output.
+ *
+ * NS_LOG writes formatted lines to std::clog on the simulation thread, and
+ * the writes to the terminal or file then dominate verbose runs. Once
+ * started, AsyncLog takes over std::clog: each line is stamped with the
+ * simulation time and context, split into an interned format and its
+ * numeric arguments, and pushed as a binary record into a single producer,
+ * single consumer ring buffer. A writer thread drains the ring to the file in
+ * large writes. log-format turns the file back into text.
+ *
+ * The text of a line is still built by NS_LOG itself, which cannot be
+ * changed from a scenario; the gain is that the simulation thread never
+ * blocks on I/O unless the ring is full.
+ *
+ * The writer thread does not survive fork(), Stop() must be called before
+ * forking, and Start() in the process that runs the simulation. Stop() must
+ * also be called before Simulator::Destroy(), logs written while the
+ * simulator is destroyed go to std::clog again.
+ */
+class AsyncLog
+{
+  public:
+    /// Default size of the ring buffer [bytes]
+    static const uint32_t defaultRingSize = 16 << 20;
+
+    AsyncLog();
+    ~AsyncLog();
+
+    /**
+     * Create the log file, start the writer thread and redirect std::clog.
+     *
+     * \param fileName The log filename.
+     * \param ringSize The ring buffer size [bytes], rounded up to a power of 2.
+     */
+    void Start(const std::string &fileName, uint32_t ringSize = defaultRingSize);
+    /// Restore std::clog, write every pending record and stop the writer thread
+    void Stop();
+    /// \return True between Start() and Stop()
+    bool IsRunning() const;
+
+    /// \return The number of records logged
+    uint64_t GetNRecords() const;
+    /// \return The number of records that waited for the writer on a full ring
+    uint64_t GetNStalls() const;
+
+  private:
+    /// Collects the characters written to std::clog into lines
+    class LineBuffer : public std::streambuf
+    {
+      public:
+        /**
+         * \param log The log the complete lines are handed to.
+         */
+        explicit LineBuffer(AsyncLog *log);
+
+        /// Hand the line not ended yet to the log, if any
+        void CommitPartial();
+
+      protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *s, std::streamsize n) override;
+
+      private:
+        AsyncLog *m_log;    //!< Log the lines are handed to
+        std::string m_line; //!< Current line
+    };
+
+    /**
+     * Encode a line as a record, and its format if it is new.
+     *
+     * \param line The line, without its end of line.
+     */
+    void Commit(const std::string &line);
+    /**
+     * Copy bytes into the ring, waiting for the writer while it is full.
+     *
+     * \param data The bytes.
+     * \param size The number of bytes.
+     */
+    void Push(const char *data, uint32_t size);
+    /// Writer thread body
+    void Drain();
+
+    std::ofstream m_file;                                //!< Log file
+    std::vector<char> m_ring;                            //!< Ring buffer
+    uint64_t m_mask;                                     //!< Ring size - 1
+    std::atomic<uint64_t> m_head;                        //!< Bytes pushed, written by the producer
+    std::atomic<uint64_t> m_tail;                        //!< Bytes drained, written by the writer
+    std::atomic<bool> m_stopping;                        //!< Whether the writer must exit once empty
+    std::thread m_writer;                                //!< Writer thread
+    std::streambuf *m_clogBuffer;                        //!< Buffer of std::clog before Start()
+    LineBuffer m_lineBuffer;                             //!< Buffer of std::clog while running
+    std::unordered_map<std::string, uint32_t> m_formats; //!< Interned formats
+    std::string m_record;                                //!< Record being encoded
+    uint64_t m_nRecords;                                 //!< Records logged
+    uint64_t m_nStalls;                                  //!< Waits on a full ring
+};
+
+/**
+ * \brief Reads back the records of a log file written by AsyncLog.
+ */
+class AsyncLogReader
+{
+  public:
+    /**
+     * Open a log file and check its header.
+     *
+     * \param fileName The log filename.
+     * \return False if the file cannot be read or is not a log file.
+     */
+    bool Open(const std::string &fileName);
+    /**
+     * Read the next record, defining formats on the way.
+     *
+     * \param timeNs Filled with the time of the record [ns].
+     * \param context Filled with the context of the record, usually the node id.
+     * \param line Filled with the text of the record.
+     * \return False at the end of the file or on a truncated record.
+     */
+    bool Read(int64_t &timeNs, uint32_t &context, std::string &line);
+
+  private:
+    std::ifstream m_file;               //!< Log file
+    std::vector<std::string> m_formats; //!< Formats, indexed by id
+};
+
+inline AsyncLog::LineBuffer::LineBuffer(AsyncLog *log)
+    : m_log(log)
+{
+}
+
+inline AsyncLog::LineBuffer::int_type AsyncLog::LineBuffer::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        return traits_type::not_eof(c);
+    }
+    char ch = traits_type::to_char_type(c);
+    xsputn(&ch, 1);
+    return c;
+}
+
+inline std::streamsize AsyncLog::LineBuffer::xsputn(const char *s, std::streamsize n)
+{
+    for (std::streamsize i = 0; i < n; i++)
+    {
+        if (s[i] == '\n')
+        {
+            m_log->Commit(m_line);
+            m_line.clear();
+        }
+        else
+        {
+            m_line += s[i];
+        }
+    }
+    return n;
+}
+
+inline void AsyncLog::LineBuffer::CommitPartial()
+{
+    if (!m_line.empty())
+    {
+        m_log->Commit(m_line);
+        m_line.clear();
+    }
+}
+
+inline AsyncLog::AsyncLog()
+    : m_mask(0),
+      m_head(0),
+      m_tail(0),
+      m_stopping(false),
+      m_clogBuffer(nullptr),
+      m_lineBuffer(this),
+      m_nRecords(0),
+      m_nStalls(0)
+{
+}
+
+inline AsyncLog::~AsyncLog()
+{
+    Stop();
+}
+
+inline bool AsyncLog::IsRunning() const
+{
+    return m_clogBuffer != nullptr;
+}
+
+inline uint64_t AsyncLog::GetNRecords() const
+{
+    return m_nRecords;
+}
+
+inline uint64_t AsyncLog::GetNStalls() const
+{
+    return m_nStalls;
+}
+
+inline void AsyncLog::Start(const std::string &fileName, uint32_t ringSize)
+{
+    NS_ABORT_MSG_IF(IsRunning(), "The log is already started");
+    m_file.open(fileName, std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_file, "Cannot open log file " << fileName);
+    m_file.write(logMagic, sizeof(logMagic));
+    m_file.write(reinterpret_cast<const char *>(&logVersion), sizeof(logVersion));
+
+    uint64_t size = 1;
+    while (size < ringSize)
+    {
+        size <<= 1;
+    }
+    m_ring.assign(size, 0);
+    m_mask = size - 1;
+    m_head = 0;
+    m_tail = 0;
+    m_stopping = false;
+    m_formats.clear();
+    m_writer = std::thread(&AsyncLog::Drain, this);
+    m_clogBuffer = std::clog.rdbuf(&m_lineBuffer);
+}
+
+inline void AsyncLog::Stop()
+{
+    if (!IsRunning())
+    {
+        return;
+    }
+    // A line not ended yet would otherwise be lost, or end up in the next log
+    m_lineBuffer.CommitPartial();
+    std::clog.rdbuf(m_clogBuffer);
+    m_clogBuffer = nullptr;
+    m_stopping.store(true, std::memory_order_release);
+    m_writer.join();
+    m_file.close();
+}
+
+inline void AsyncLog::Commit(const std::string &line)
+{
+    // Numbers are the arguments, the rest of the line is the format
+    std::string format;
+    std::vector<std::string> args;
+    for (std::size_t i = 0; i < line.size();)
+    {
+        if (line[i] < '0' || line[i] > '9' || args.size() == 255)
+        {
+            format += line[i++];
+            continue;
+        }
+        std::size_t end = i;
+        while (end < line.size() && end - i < 255 &&
+               ((line[end] >= '0' && line[end] <= '9') ||
+                (line[end] == '.' && end + 1 < line.size() && line[end + 1] >= '0' &&
+                 line[end + 1] <= '9')))
+        {
+            end++;
+        }
+        args.push_back(line.substr(i, end - i));
+        format += logArgMarker;
+        i = end;
+    }
+
+    m_record.clear();
+    auto put = [this](const void *data, std::size_t size) {
+        m_record.append(static_cast<const char *>(data), size);
+    };
+    auto id = m_formats.find(format);
+    if (id == m_formats.end())
+    {
+        id = m_formats.emplace(format, m_formats.size()).first;
+        uint32_t length = format.size();
+        m_record += 'F';
+        put(&id->second, sizeof(id->second));
+        put(&length, sizeof(length));
+        put(format.data(), length);
+    }
+    int64_t time = Simulator::Now().GetNanoSeconds();
+    uint32_t context = Simulator::GetContext();
+    uint8_t nArgs = args.size();
+    m_record += 'R';
+    put(&time, sizeof(time));
+    put(&context, sizeof(context));
+    put(&id->second, sizeof(id->second));
+    put(&nArgs, sizeof(nArgs));
+    for (const auto &arg : args)
+    {
+        uint8_t length = arg.size();
+        put(&length, sizeof(length));
+        put(arg.data(), length);
+    }
+    Push(m_record.data(), m_record.size());
+    m_nRecords++;
+}
+
+inline void AsyncLog::Push(const char *data, uint32_t size)
+{
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    bool stalled = false;
+    while (size > 0)
+    {
+        uint64_t space = m_ring.size() - (head - m_tail.load(std::memory_order_acquire));
+        if (space == 0)
+        {
+            m_nStalls += stalled ? 0 : 1;
+            stalled = true;
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t offset = head & m_mask;
+        uint64_t chunk = std::min<uint64_t>({size, space, m_ring.size() - offset});
+        std::memcpy(&m_ring[offset], data, chunk);
+        data += chunk;
+        size -= chunk;
+        head += chunk;
+        m_head.store(head, std::memory_order_release);
+    }
+}
+
+inline void AsyncLog::Drain()
+{
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+        // Read the flag first, so that nothing pushed before Stop() is missed
+        bool stopping = m_stopping.load(std::memory_order_acquire);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        if (head == tail)
+        {
+            if (stopping)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        while (tail != head)
+        {
+            uint64_t offset = tail & m_mask;
+            uint64_t chunk = std::min<uint64_t>(head - tail, m_ring.size() - offset);
+            m_file.write(&m_ring[offset], chunk);
+            tail += chunk;
+        }
+        m_tail.store(tail, std::memory_order_release);
+    }
+    m_file.flush();
+}
+
+inline bool AsyncLogReader::Open(const std::string &fileName)
+{
+    m_file.open(fileName, std::ios::binary);
+    char magic[sizeof(logMagic)];
+    uint32_t version = 0;
+    m_file.read(magic, sizeof(magic));
+    m_file.read(reinterpret_cast<char *>(&version), sizeof(version));
+    return m_file && std::memcmp(magic, logMagic, sizeof(magic)) == 0 && version == logVersion;
+}
+
+inline bool AsyncLogReader::Read(int64_t &timeNs, uint32_t &context, std::string &line)
+{
+    char type;
+    while (m_file.get(type) && type == 'F')
+    {
+        uint32_t id;
+        uint32_t length;
+        m_file.read(reinterpret_cast<char *>(&id), sizeof(id));
+        m_file.read(reinterpret_cast<char *>(&length), sizeof(length));
+        std::string format(length, '\0');
+        m_file.read(&format[0], length);
+        if (!m_file)
+        {
+            return false;
+        }
+        if (id >= m_formats.size())
+        {
+            m_formats.resize(id + 1);
+        }
+        m_formats[id] = format;
+    }
+    if (!m_file || type != 'R')
+    {
+        return false;
+    }
+
+    uint32_t id;
+    uint8_t nArgs;
+    m_file.read(reinterpret_cast<char *>(&timeNs), sizeof(timeNs));
+    m_file.read(reinterpret_cast<char *>(&context), sizeof(context));
+    m_file.read(reinterpret_cast<char *>(&id), sizeof(id));
+    m_file.read(reinterpret_cast<char *>(&nArgs), sizeof(nArgs));
+    if (!m_file || id >= m_formats.size())
+    {
+        return false;
+    }
+    std::vector<std::string> args(nArgs);
+    for (auto &arg : args)
+    {
+        uint8_t length;
+        m_file.read(reinterpret_cast<char *>(&length), sizeof(length));
+        arg.resize(length);
+        m_file.read(&arg[0], length);
+    }
+    if (!m_file)
+    {
+        return false;
+    }
+    line.clear();
+    std::size_t arg = 0;
+    for (char c : m_formats[id])
+    {
+        if (c == logArgMarker && arg < args.size())
+        {
+            line += args[arg++];
+        }
+        else
+        {
+            line += c;
+        }
+    }
+    return true;
+}
+
+} // namespace ns3
+
+#endif /* ASYNC_LOG_H */
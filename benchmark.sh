@@ -0,0 +1,101 @@
+#!/bin/bash
+#
+# Run every scenario headless and append one JSON performance report per run
+# (wall time, events per second, peak RSS, simulated seconds per wall second)
+# to a results file.
+#
+# Run from the ns-3 root, with the scenarios copied into scratch/:
+#
+#   scratch/benchmark.sh [results.jsonl]
+#
+# Configure ns-3 with --build-profile=optimized so that results can be compared
+# between ns-3 versions. Environment:
+#
+#   NS3          ns3 driver (default ./ns3)
+#   REPEAT       runs of every configuration (default 3)
+#   NCSMA        TFE-topology-UDP nCsma series, run with shared and switched LANs
+#   STEPS        researchCase steps series
+#   SCHEDULERS   event schedulers compared on every scenario, with the largest
+#                nCsma and steps of the series
+#   MPIEXEC      MPI launcher, e.g. "mpiexec -np 2", to also run the distributed
+#                scenarios (needs ns-3 configured with --enable-mpi)
+#   PACKET_POOL  1 to also run with pooled allocations (needs ns-3 configured
+#                with CXXFLAGS=-DPACKET_POOL_REPLACE_NEW). In such a build every
+#                run goes through the replaced operator new, compare the pooled
+#                runs with the results of a build without it
+
+set -e
+
+NS3=${NS3:-./ns3}
+REPEAT=${REPEAT:-3}
+NCSMA=${NCSMA:-"4 8 16 32 64 128 256 512 1024 2048 4096"}
+STEPS=${STEPS:-"25 50 100 200 400"}
+SCHEDULERS=${SCHEDULERS:-"map heap list calendar ladder"}
+PACKET_POOL=${PACKET_POOL:-0}
+RESULTS=$(realpath -m "${1:-benchmark-$(date +%Y%m%d-%H%M%S).jsonl}")
+
+# Run a scenario headless, its report is appended to the results file
+run()
+{
+    local program=$1
+    shift
+    for ((i = 0; i < REPEAT; i++)); do
+        echo "$program $*"
+        "$NS3" run --no-build "scratch/$program --headless=1 --perfReport=$RESULTS $*" > /dev/null
+    done
+}
+
+# Same as run, on two MPI ranks
+run_mpi()
+{
+    local program=$1
+    shift
+    for ((i = 0; i < REPEAT; i++)); do
+        echo "$MPIEXEC $program $*"
+        "$NS3" run --no-build --command-template="$MPIEXEC %s" \
+            "scratch/$program --headless=1 --perfReport=$RESULTS --mpi=1 $*" > /dev/null
+    done
+}
+
+"$NS3" build
+
+# The routes updated incrementally at a link down must match a full SPF
+for mode in shared switched; do
+    echo "TFE-topology-UDP --lanMode=$mode --linkDown=5 --checkRoutes=1"
+    "$NS3" run --no-build \
+        "scratch/TFE-topology-UDP --headless=1 --lanMode=$mode --linkDown=5 --checkRoutes=1" > /dev/null
+done
+
+run PedagogicalCase --flowmon=0
+run TFE-topology-TCP
+
+for mode in shared switched; do
+    for n in $NCSMA; do
+        run TFE-topology-UDP --nCsma="$n" --lanMode="$mode"
+    done
+done
+
+for steps in $STEPS; do
+    run researchCase --steps="$steps"
+done
+
+for scheduler in $SCHEDULERS; do
+    run PedagogicalCase --flowmon=0 --scheduler="$scheduler"
+    run TFE-topology-TCP --scheduler="$scheduler"
+    run TFE-topology-UDP --nCsma="${NCSMA##* }" --scheduler="$scheduler"
+    run researchCase --steps="${STEPS##* }" --scheduler="$scheduler"
+done
+
+if [ "$PACKET_POOL" = 1 ]; then
+    run TFE-topology-TCP --packetPool=1
+    run researchCase --steps="${STEPS##* }" --packetPool=1
+fi
+
+if [ -n "$MPIEXEC" ]; then
+    run_mpi PedagogicalCase --flowmon=0
+    for n in $NCSMA; do
+        run_mpi TFE-topology-UDP --nCsma="$n"
+    done
+fi
+
+echo "Results appended to $RESULTS"
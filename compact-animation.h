@@ -0,0 +1,581 @@
+#ifndef COMPACT_ANIMATION_H
+#define COMPACT_ANIMATION_H
+
+#include "ns3/abort.h"
+#include "ns3/callback.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4.h"
+#include "ns3/mobility-model.h"
+#include "ns3/net-device.h"
+#include "ns3/node-list.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace ns3
+{
+
+/*
+ * Animation file layout, in host byte order:
+ *
+ *   "NSAN" | uint32 version
+ *   then any number of blocks, each starting with a type byte:
+ *   'N' | uint32 nNodes | nNodes x (uint32 id, double x, double y, uint32 length, description)
+ *   'E' | uint32 nEvents | uint32 nBytes | nBytes of encoded events
+ *
+ * An event is a kind byte followed by varints: time since the previous event
+ * [ns], zigzag node delta, device index, zigzag packet uid delta, and the
+ * packet size for a transmission start. Deltas restart from zero at every
+ * block, so each block decodes on its own and a file cut short by a crash
+ * still holds every flushed block.
+ */
+
+/// Magic number at the start of an animation file
+static const char animMagic[4] = {'N', 'S', 'A', 'N'};
+/// Version of the animation file layout
+static const uint32_t animVersion = 1;
+
+/// A node of a compact animation
+struct AnimNode
+{
+    uint32_t id;             ///< Node id
+    double x;                ///< Position x [m]
+    double y;                ///< Position y [m]
+    std::string description; ///< Label shown by NetAnim
+};
+
+/// A packet event of a compact animation
+struct AnimEvent
+{
+    /// Kinds of events
+    enum Kind
+    {
+        TX_BEGIN,
+        TX_END,
+        RX_END
+    };
+
+    uint8_t kind;    ///< Kind of event
+    int64_t timeNs;  ///< Time of the event [ns]
+    uint32_t node;   ///< Node id
+    uint32_t device; ///< Device index on the node
+    uint64_t uid;    ///< Packet uid
+    uint32_t size;   ///< Packet size [bytes], TX_BEGIN only
+};
+
+/**
+ * \brief Sampled packet animation written as a compact binary stream.
+ *
+ * Replaces AnimationInterface packet tracing, which writes an XML element per
+ * packet and per hop: the PHY transmission and reception events of wired
+ * devices are delta and varint encoded into blocks, and anim-convert turns the
+ * file into NetAnim XML offline.
+ *
+ * Only 1 packet in N is recorded, picked by uid so that all the hops of a
+ * packet are kept, or, with per-flow sampling, every packet of 1 IPv4 flow in
+ * N, picked by hashing the addresses, protocol and ports when the packet is
+ * sent. Events outside the [start, stop] window are dropped.
+ *
+ * Node positions are read from their mobility model, e.g. set with
+ * AnimationInterface::SetConstantPosition(), when the simulation starts.
+ */
+class CompactAnimation
+{
+  public:
+    /// Events kept in memory before a block is written out
+    static const uint32_t maxBufferedEvents = 4096;
+
+    /**
+     * Create the animation file.
+     *
+     * \param fileName The animation filename.
+     */
+    CompactAnimation(const std::string &fileName);
+    ~CompactAnimation();
+
+    /**
+     * \param sampleN Record 1 packet, or 1 flow, in sampleN.
+     * \param perFlow Sample flows instead of packets.
+     */
+    void SetSampling(uint32_t sampleN, bool perFlow);
+    /**
+     * \param start Time the recording starts.
+     * \param stop Time the recording stops, zero to record until the end.
+     */
+    void SetWindow(Time start, Time stop);
+    /**
+     * \param node A node.
+     * \param description The label shown by NetAnim.
+     */
+    void UpdateNodeDescription(Ptr<Node> node, const std::string &description);
+
+    /// Connect the traces of every node, call once the topology is built
+    void Install();
+
+    /// \return The number of events recorded
+    uint64_t GetNEvents() const;
+
+  private:
+    /**
+     * Trace sinks for the PHY transmission start and end and reception end.
+     *
+     * \param animation The animation.
+     * \param node The node id.
+     * \param device The device index.
+     * \param packet The packet.
+     */
+    static void TxBegin(CompactAnimation *animation,
+                        uint32_t node,
+                        uint32_t device,
+                        Ptr<const Packet> packet);
+    /// \copydoc TxBegin
+    static void TxEnd(CompactAnimation *animation,
+                      uint32_t node,
+                      uint32_t device,
+                      Ptr<const Packet> packet);
+    /// \copydoc TxBegin
+    static void RxEnd(CompactAnimation *animation,
+                      uint32_t node,
+                      uint32_t device,
+                      Ptr<const Packet> packet);
+    /**
+     * Record a PHY event of a sampled packet.
+     *
+     * \param kind The kind of event.
+     * \param node The node id.
+     * \param device The device index.
+     * \param packet The packet.
+     */
+    void Record(uint8_t kind, uint32_t node, uint32_t device, Ptr<const Packet> packet);
+    /**
+     * Trace sink for the packets sent by the IPv4 layer, picks the sampled flows.
+     *
+     * \param header The IPv4 header.
+     * \param packet The packet, without its IPv4 header.
+     * \param interface The output interface.
+     */
+    void SendOutgoing(const Ipv4Header &header, Ptr<const Packet> packet, uint32_t interface);
+    /**
+     * \param packet A packet.
+     * \return True if the packet is recorded.
+     */
+    bool IsSampled(Ptr<const Packet> packet) const;
+
+    /// Write the node block
+    void WriteNodes();
+    /// Write the pending events as a block
+    void Flush();
+    /**
+     * \param value Appended to the pending block as a varint.
+     */
+    void PutVarint(uint64_t value);
+    /**
+     * \param value Appended to the pending block as a zigzag varint.
+     */
+    void PutSigned(int64_t value);
+
+    std::ofstream m_file;                           //!< Animation file
+    std::map<uint32_t, std::string> m_descriptions; //!< Node labels
+    uint32_t m_sampleN;                             //!< Sampling ratio
+    bool m_perFlow;                                 //!< Sample flows instead of packets
+    Time m_start;                                   //!< Start of the recording
+    Time m_stop;                                    //!< End of the recording, zero for none
+    std::unordered_set<uint64_t> m_flowPackets[2];  //!< Uids of sampled flows, two generations
+    Time m_generationStart;                         //!< Start of the current uid generation
+    std::vector<uint8_t> m_block;                   //!< Pending encoded events
+    uint32_t m_blockEvents;                         //!< Pending events
+    int64_t m_lastTime;                             //!< Time of the previous event [ns]
+    uint32_t m_lastNode;                            //!< Node of the previous event
+    uint64_t m_lastUid;                             //!< Packet uid of the previous event
+    uint64_t m_nEvents;                             //!< Events recorded
+};
+
+/**
+ * \brief Reads back the blocks of an animation file written by CompactAnimation.
+ */
+class CompactAnimationReader
+{
+  public:
+    /**
+     * Open an animation file and check its header.
+     *
+     * \param fileName The animation filename.
+     * \return False if the file cannot be read or is not an animation file.
+     */
+    bool Open(const std::string &fileName);
+    /// Go back to the first block
+    void Rewind();
+    /**
+     * Read the next complete block, which holds either nodes or events.
+     *
+     * \param nodes Filled with the nodes of a node block, cleared otherwise.
+     * \param events Filled with the events of an event block, cleared otherwise.
+     * \return False at the end of the file or on a truncated or corrupt block.
+     */
+    bool ReadBlock(std::vector<AnimNode> &nodes, std::vector<AnimEvent> &events);
+
+  private:
+    /**
+     * \param value Filled with the value read.
+     * \return False on a short read.
+     */
+    bool ReadU32(uint32_t &value);
+
+    std::ifstream m_file;        //!< Animation file
+    std::streampos m_firstBlock; //!< Offset of the first block
+};
+
+inline CompactAnimation::CompactAnimation(const std::string &fileName)
+    : m_sampleN(1),
+      m_perFlow(false),
+      m_start(Seconds(0)),
+      m_stop(Seconds(0)),
+      m_generationStart(Seconds(0)),
+      m_blockEvents(0),
+      m_lastTime(0),
+      m_lastNode(0),
+      m_lastUid(0),
+      m_nEvents(0)
+{
+    m_file.open(fileName, std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_file, "Cannot open animation file " << fileName);
+    m_file.write(animMagic, sizeof(animMagic));
+    m_file.write(reinterpret_cast<const char *>(&animVersion), sizeof(animVersion));
+    m_block.reserve(maxBufferedEvents * 16);
+}
+
+inline CompactAnimation::~CompactAnimation()
+{
+    Flush();
+}
+
+inline void CompactAnimation::SetSampling(uint32_t sampleN, bool perFlow)
+{
+    NS_ABORT_MSG_IF(sampleN == 0, "The animation sampling ratio must be at least 1");
+    m_sampleN = sampleN;
+    m_perFlow = perFlow;
+}
+
+inline void CompactAnimation::SetWindow(Time start, Time stop)
+{
+    m_start = start;
+    m_stop = stop;
+}
+
+inline void CompactAnimation::UpdateNodeDescription(Ptr<Node> node, const std::string &description)
+{
+    m_descriptions[node->GetId()] = description;
+}
+
+inline uint64_t CompactAnimation::GetNEvents() const
+{
+    return m_nEvents;
+}
+
+inline void CompactAnimation::Install()
+{
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); n++)
+    {
+        Ptr<Node> node = NodeList::GetNode(n);
+        // Devices without PHY traces, e.g. bridges, are skipped
+        for (uint32_t d = 0; d < node->GetNDevices(); d++)
+        {
+            Ptr<NetDevice> device = node->GetDevice(d);
+            device->TraceConnectWithoutContext(
+                "PhyTxBegin",
+                MakeBoundCallback(&CompactAnimation::TxBegin, this, n, d));
+            device->TraceConnectWithoutContext(
+                "PhyTxEnd",
+                MakeBoundCallback(&CompactAnimation::TxEnd, this, n, d));
+            device->TraceConnectWithoutContext(
+                "PhyRxEnd",
+                MakeBoundCallback(&CompactAnimation::RxEnd, this, n, d));
+        }
+        Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+        if (m_perFlow && ipv4)
+        {
+            ipv4->TraceConnectWithoutContext("SendOutgoing",
+                                             MakeCallback(&CompactAnimation::SendOutgoing, this));
+        }
+    }
+    // Positions and labels are final once the simulation starts
+    Simulator::Schedule(Seconds(0), &CompactAnimation::WriteNodes, this);
+}
+
+inline void CompactAnimation::WriteNodes()
+{
+    Flush();
+    uint32_t nNodes = NodeList::GetNNodes();
+    m_file.put('N');
+    m_file.write(reinterpret_cast<const char *>(&nNodes), sizeof(nNodes));
+    for (uint32_t n = 0; n < nNodes; n++)
+    {
+        Ptr<MobilityModel> mobility = NodeList::GetNode(n)->GetObject<MobilityModel>();
+        Vector position = mobility ? mobility->GetPosition() : Vector(0, 0, 0);
+        const std::string &description = m_descriptions[n];
+        uint32_t length = description.size();
+        m_file.write(reinterpret_cast<const char *>(&n), sizeof(n));
+        m_file.write(reinterpret_cast<const char *>(&position.x), sizeof(position.x));
+        m_file.write(reinterpret_cast<const char *>(&position.y), sizeof(position.y));
+        m_file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+        m_file.write(description.data(), length);
+    }
+    m_file.flush();
+}
+
+inline void CompactAnimation::SendOutgoing(const Ipv4Header &header,
+                                           Ptr<const Packet> packet,
+                                           uint32_t /* interface */)
+{
+    // Ports are the first 4 bytes of the TCP and UDP headers
+    uint8_t ports[4] = {0, 0, 0, 0};
+    if (header.GetProtocol() == 6 || header.GetProtocol() == 17)
+    {
+        packet->CopyData(ports, sizeof(ports));
+    }
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](uint32_t value) {
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 1099511628211ULL;
+        }
+    };
+    mix(header.GetSource().Get());
+    mix(header.GetDestination().Get());
+    mix(header.GetProtocol());
+    mix(ports[0] | ports[1] << 8 | ports[2] << 16 | ports[3] << 24);
+    if (hash % m_sampleN != 0)
+    {
+        return;
+    }
+    // Uids of the previous generation are dropped after a second, so that the
+    // sets stay small; no packet lives that long in these topologies
+    if (Simulator::Now() - m_generationStart > Seconds(1))
+    {
+        m_flowPackets[1].swap(m_flowPackets[0]);
+        m_flowPackets[0].clear();
+        m_generationStart = Simulator::Now();
+    }
+    m_flowPackets[0].insert(packet->GetUid());
+}
+
+inline bool CompactAnimation::IsSampled(Ptr<const Packet> packet) const
+{
+    if (!m_perFlow)
+    {
+        return packet->GetUid() % m_sampleN == 0;
+    }
+    return m_flowPackets[0].count(packet->GetUid()) || m_flowPackets[1].count(packet->GetUid());
+}
+
+inline void CompactAnimation::TxBegin(CompactAnimation *animation,
+                                      uint32_t node,
+                                      uint32_t device,
+                                      Ptr<const Packet> packet)
+{
+    animation->Record(AnimEvent::TX_BEGIN, node, device, packet);
+}
+
+inline void CompactAnimation::TxEnd(CompactAnimation *animation,
+                                    uint32_t node,
+                                    uint32_t device,
+                                    Ptr<const Packet> packet)
+{
+    animation->Record(AnimEvent::TX_END, node, device, packet);
+}
+
+inline void CompactAnimation::RxEnd(CompactAnimation *animation,
+                                    uint32_t node,
+                                    uint32_t device,
+                                    Ptr<const Packet> packet)
+{
+    animation->Record(AnimEvent::RX_END, node, device, packet);
+}
+
+inline void CompactAnimation::Record(uint8_t kind,
+                                     uint32_t node,
+                                     uint32_t device,
+                                     Ptr<const Packet> packet)
+{
+    Time now = Simulator::Now();
+    if (now < m_start || (!m_stop.IsZero() && now > m_stop) || !IsSampled(packet))
+    {
+        return;
+    }
+    int64_t time = now.GetNanoSeconds();
+    m_block.push_back(kind);
+    PutVarint(time - m_lastTime);
+    PutSigned(static_cast<int64_t>(node) - m_lastNode);
+    PutVarint(device);
+    PutSigned(static_cast<int64_t>(packet->GetUid() - m_lastUid));
+    if (kind == AnimEvent::TX_BEGIN)
+    {
+        PutVarint(packet->GetSize());
+    }
+    m_lastTime = time;
+    m_lastNode = node;
+    m_lastUid = packet->GetUid();
+    m_nEvents++;
+    if (++m_blockEvents >= maxBufferedEvents)
+    {
+        Flush();
+    }
+}
+
+inline void CompactAnimation::PutVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        m_block.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    m_block.push_back(static_cast<uint8_t>(value));
+}
+
+inline void CompactAnimation::PutSigned(int64_t value)
+{
+    PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+inline void CompactAnimation::Flush()
+{
+    if (m_blockEvents == 0)
+    {
+        return;
+    }
+    uint32_t nBytes = m_block.size();
+    m_file.put('E');
+    m_file.write(reinterpret_cast<const char *>(&m_blockEvents), sizeof(m_blockEvents));
+    m_file.write(reinterpret_cast<const char *>(&nBytes), sizeof(nBytes));
+    m_file.write(reinterpret_cast<const char *>(m_block.data()), nBytes);
+    m_file.flush();
+    m_block.clear();
+    m_blockEvents = 0;
+    m_lastTime = 0;
+    m_lastNode = 0;
+    m_lastUid = 0;
+}
+
+inline bool CompactAnimationReader::ReadU32(uint32_t &value)
+{
+    m_file.read(reinterpret_cast<char *>(&value), sizeof(value));
+    return m_file.gcount() == sizeof(value);
+}
+
+inline bool CompactAnimationReader::Open(const std::string &fileName)
+{
+    m_file.open(fileName, std::ios::binary);
+    char magic[sizeof(animMagic)];
+    m_file.read(magic, sizeof(magic));
+    uint32_t version;
+    if (!m_file || std::memcmp(magic, animMagic, sizeof(magic)) != 0 || !ReadU32(version) ||
+        version != animVersion)
+    {
+        return false;
+    }
+    m_firstBlock = m_file.tellg();
+    return true;
+}
+
+inline void CompactAnimationReader::Rewind()
+{
+    m_file.clear();
+    m_file.seekg(m_firstBlock);
+}
+
+inline bool CompactAnimationReader::ReadBlock(std::vector<AnimNode> &nodes,
+                                              std::vector<AnimEvent> &events)
+{
+    nodes.clear();
+    events.clear();
+    char type;
+    uint32_t count;
+    if (!m_file.get(type) || !ReadU32(count))
+    {
+        return false;
+    }
+
+    if (type == 'N')
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            AnimNode node;
+            uint32_t length;
+            m_file.read(reinterpret_cast<char *>(&node.id), sizeof(node.id));
+            m_file.read(reinterpret_cast<char *>(&node.x), sizeof(node.x));
+            m_file.read(reinterpret_cast<char *>(&node.y), sizeof(node.y));
+            if (!ReadU32(length))
+            {
+                return false;
+            }
+            node.description.resize(length);
+            m_file.read(&node.description[0], length);
+            nodes.push_back(node);
+        }
+        return static_cast<bool>(m_file);
+    }
+
+    uint32_t nBytes;
+    if (type != 'E' || !ReadU32(nBytes))
+    {
+        return false;
+    }
+    std::vector<uint8_t> bytes(nBytes);
+    m_file.read(reinterpret_cast<char *>(bytes.data()), nBytes);
+    if (m_file.gcount() != static_cast<std::streamsize>(nBytes))
+    {
+        return false;
+    }
+    uint32_t offset = 0;
+    bool truncated = false;
+    auto getVarint = [&]() {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7)
+        {
+            if (offset >= nBytes)
+            {
+                truncated = true;
+                return value;
+            }
+            uint8_t byte = bytes[offset++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+        return value;
+    };
+    auto getSigned = [&]() {
+        uint64_t value = getVarint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    };
+    AnimEvent event = {0, 0, 0, 0, 0, 0};
+    for (uint32_t i = 0; i < count && !truncated; i++)
+    {
+        if (offset >= nBytes)
+        {
+            return false;
+        }
+        event.kind = bytes[offset++];
+        event.timeNs += getVarint();
+        event.node += getSigned();
+        event.device = getVarint();
+        event.uid += getSigned();
+        event.size = event.kind == AnimEvent::TX_BEGIN ? getVarint() : 0;
+        events.push_back(event);
+    }
+    return !truncated;
+}
+
+} // namespace ns3
+
+#endif /* COMPACT_ANIMATION_H */
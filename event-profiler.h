@@ -0,0 +1,474 @@
+#ifndef EVENT_PROFILER_H
+#define EVENT_PROFILER_H
+
+#include "ns3/abort.h"
+#include "ns3/config.h"
+#include "ns3/default-simulator-impl.h"
+#include "ns3/event-impl.h"
+#include "ns3/global-value.h"
+#include "ns3/string.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+
+namespace ns3
+{
+
+/**
+ * \brief Simulator that profiles its events by target function.
+ *
+ * Every event scheduled is wrapped so that its execution is timed. The type
+ * of an event only tells the signature of the function it calls, e.g.
+ * void (NodeStatistics::*)(Ptr<Node>, Ptr<NodeStatistics>) for every method
+ * of the same class with the same arguments, so events are attributed to a
+ * target made of that signature and of the function that scheduled them,
+ * e.g. NodeStatistics::AdvancePosition for the event that moves the STA next.
+ * The scheduling function is the first caller outside of the simulator and of
+ * Timer, found with backtrace() and named with dladdr(), once per call site.
+ * Functions of the scenario itself are only named when it is linked with
+ * -rdynamic, otherwise they read as executable+offset.
+ *
+ * Trace sinks run inside the event that fires the trace and are counted in
+ * it. The time spent wrapping the events an event schedules is taken out of
+ * that event and reported on its own profiler row. For each target the count of executed events, their cumulative and
+ * longest wall time, and the number of events pending in the scheduler when
+ * they ran are collected.
+ *
+ * At Simulator::Destroy() a report sorted by cumulative time is written to
+ * the ReportFile, and the same times in the folded stack format of
+ * flamegraph.pl to ReportFile.folded, the scheduling function being the
+ * parent frame of the target.
+ *
+ * Enable() selects this simulator, before any other use of the simulator. It
+ * replaces the default simulator, so it cannot be combined with the
+ * distributed ones.
+ */
+class ProfilingSimulatorImpl : public DefaultSimulatorImpl
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    ProfilingSimulatorImpl();
+
+    /**
+     * Use this simulator for the run.
+     *
+     * \param fileName The report filename.
+     */
+    static void Enable(const std::string &fileName);
+
+    void Run() override;
+    void Destroy() override;
+    EventId Schedule(const Time &delay, EventImpl *event) override;
+    void ScheduleWithContext(uint32_t context, const Time &delay, EventImpl *event) override;
+    EventId ScheduleNow(EventImpl *event) override;
+    void Remove(const EventId &id) override;
+    void Cancel(const EventId &id) override;
+
+  private:
+    /// Statistics of the events of one target
+    struct Target
+    {
+        std::string name;  ///< Readable signature of the target
+        std::string site;  ///< Function that scheduled the events
+        uint64_t count;    ///< Events executed
+        uint64_t totalNs;  ///< Cumulative wall time [ns]
+        uint64_t maxNs;    ///< Longest execution [ns]
+        uint64_t depthSum; ///< Sum of the pending events at each execution
+        uint64_t maxDepth; ///< Most pending events at an execution
+    };
+
+    /// Times the event it wraps
+    class ProfiledEvent : public EventImpl
+    {
+      public:
+        /**
+         * \param simulator The profiling simulator.
+         * \param target The statistics of the event target.
+         * \param event The wrapped event, owned by the wrapper.
+         */
+        ProfiledEvent(ProfilingSimulatorImpl *simulator, Target *target, EventImpl *event);
+
+      protected:
+        void Notify() override;
+
+      private:
+        ProfilingSimulatorImpl *m_simulator; //!< Profiling simulator
+        Target *m_target;                    //!< Statistics of the event target
+        Ptr<EventImpl> m_event;              //!< Wrapped event
+    };
+
+    /// Function a return address belongs to
+    struct Frame
+    {
+        const void *function; ///< Start of the function, the address itself when unknown
+        std::string name;     ///< Readable function name
+        bool internal;        ///< Whether the function belongs to the scheduling machinery
+    };
+
+    /**
+     * \param event An event.
+     * \return The wrapper timing the event.
+     */
+    EventImpl *Wrap(EventImpl *event);
+    /**
+     * \param address A return address.
+     * \return The function it belongs to, looked up once per address.
+     */
+    const Frame &GetFrame(void *address);
+    /**
+     * \param type The demangled type of an event.
+     * \return A shorter name of its target.
+     */
+    static std::string GetTargetName(const std::string &type);
+    /**
+     * \param symbol A demangled function symbol.
+     * \return The qualified function name, without return type nor arguments.
+     */
+    static std::string GetFunctionName(const std::string &symbol);
+    /**
+     * \param id An event.
+     * \return Whether the event is wrapped and still pending.
+     */
+    bool IsProfiledPending(const EventId &id);
+    /// Write the report and the folded stacks
+    void WriteReport() const;
+
+    /// Event type and scheduling function of a target
+    typedef std::pair<std::type_index, const void *> TargetKey;
+
+    std::string m_reportFile;                        //!< Report filename
+    std::map<TargetKey, Target *> m_byKey;           //!< Targets by type and scheduling function
+    std::deque<Target> m_targets;                    //!< Targets, at a fixed address
+    std::unordered_map<void *, Frame> m_frames;      //!< Functions by return address
+    uint64_t m_pending;                              //!< Wrapped events pending in the scheduler
+    uint64_t m_runNs;                                //!< Wall time of Run() [ns]
+    uint64_t m_wrapNs;                               //!< Wall time of Wrap() [ns]
+    uint64_t m_profilerNs;                           //!< Wall time of Wrap() within events [ns]
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ProfilingSimulatorImpl);
+
+inline TypeId ProfilingSimulatorImpl::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::ProfilingSimulatorImpl")
+                            .SetParent<DefaultSimulatorImpl>()
+                            .SetGroupName("Core")
+                            .AddConstructor<ProfilingSimulatorImpl>()
+                            .AddAttribute("ReportFile",
+                                          "File the profile is written to at Destroy()",
+                                          StringValue("profile.txt"),
+                                          MakeStringAccessor(&ProfilingSimulatorImpl::m_reportFile),
+                                          MakeStringChecker());
+    return tid;
+}
+
+inline ProfilingSimulatorImpl::ProfilingSimulatorImpl()
+    : m_pending(0),
+      m_runNs(0),
+      m_wrapNs(0),
+      m_profilerNs(0)
+{
+}
+
+inline void ProfilingSimulatorImpl::Enable(const std::string &fileName)
+{
+    Config::SetDefault("ns3::ProfilingSimulatorImpl::ReportFile", StringValue(fileName));
+    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::ProfilingSimulatorImpl"));
+}
+
+inline ProfilingSimulatorImpl::ProfiledEvent::ProfiledEvent(ProfilingSimulatorImpl *simulator,
+                                                             Target *target,
+                                                             EventImpl *event)
+    : m_simulator(simulator),
+      m_target(target),
+      m_event(event, false)
+{
+}
+
+inline void ProfilingSimulatorImpl::ProfiledEvent::Notify()
+{
+    uint64_t depth = --m_simulator->m_pending;
+    uint64_t wrapNs = m_simulator->m_wrapNs;
+    auto start = std::chrono::steady_clock::now();
+    m_event->Invoke();
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    // The events scheduled by this one were wrapped within its time
+    wrapNs = std::min(ns, m_simulator->m_wrapNs - wrapNs);
+    m_simulator->m_profilerNs += wrapNs;
+    ns -= wrapNs;
+    m_target->count++;
+    m_target->totalNs += ns;
+    m_target->maxNs = std::max(m_target->maxNs, ns);
+    m_target->depthSum += depth;
+    m_target->maxDepth = std::max(m_target->maxDepth, depth);
+}
+
+inline EventImpl *ProfilingSimulatorImpl::Wrap(EventImpl *event)
+{
+    auto start = std::chrono::steady_clock::now();
+    // Wrap(), Schedule*() of this simulator and Simulator::DoSchedule*() come first, then at
+    // most Simulator::Schedule<>() and Timer, unless inlined
+    const int maxFrames = 12;
+    void *stack[maxFrames];
+    int depth = backtrace(stack, maxFrames);
+    const Frame *caller = nullptr;
+    for (int i = 1; i < depth && !caller; i++)
+    {
+        const Frame &frame = GetFrame(stack[i]);
+        caller = frame.internal ? nullptr : &frame;
+    }
+
+    TargetKey key(std::type_index(typeid(*event)), caller ? caller->function : nullptr);
+    auto target = m_byKey.find(key);
+    if (target == m_byKey.end())
+    {
+        int status;
+        char *demangled = abi::__cxa_demangle(typeid(*event).name(), nullptr, nullptr, &status);
+        std::string type = status == 0 ? demangled : typeid(*event).name();
+        std::free(demangled);
+        m_targets.push_back(
+            {GetTargetName(type), caller ? caller->name : "unknown", 0, 0, 0, 0, 0});
+        target = m_byKey.emplace(key, &m_targets.back()).first;
+    }
+    m_pending++;
+    EventImpl *wrapped = new ProfiledEvent(this, target->second, event);
+    m_wrapNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    return wrapped;
+}
+
+inline const ProfilingSimulatorImpl::Frame &ProfilingSimulatorImpl::GetFrame(void *address)
+{
+    auto frame = m_frames.find(address);
+    if (frame != m_frames.end())
+    {
+        return frame->second;
+    }
+    Frame found{address, "", false};
+    Dl_info info;
+    if (dladdr(address, &info) != 0 && info.dli_sname)
+    {
+        int status;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        found.function = info.dli_saddr;
+        found.name = GetFunctionName(status == 0 ? demangled : info.dli_sname);
+        std::free(demangled);
+    }
+    else
+    {
+        std::ostringstream name;
+        std::string object = info.dli_fname ? info.dli_fname : "unknown";
+        name << object.substr(object.rfind('/') + 1) << "+0x" << std::hex
+             << (reinterpret_cast<uintptr_t>(address) -
+                 reinterpret_cast<uintptr_t>(info.dli_fbase));
+        found.name = name.str();
+    }
+    found.internal = found.name.compare(0, 11, "Simulator::") == 0 ||
+                     found.name.find("SimulatorImpl::") != std::string::npos ||
+                     found.name.compare(0, 7, "Timer::") == 0 ||
+                     found.name.compare(0, 9, "TimerImpl") == 0 ||
+                     found.name.compare(0, 9, "MakeEvent") == 0;
+    return m_frames.emplace(address, found).first->second;
+}
+
+inline std::string ProfilingSimulatorImpl::GetFunctionName(const std::string &symbol)
+{
+    std::string name = symbol;
+    for (std::size_t pos = name.find("ns3::"); pos != std::string::npos; pos = name.find("ns3::"))
+    {
+        name.erase(pos, 5);
+    }
+    // [return type ]qualified<template arguments>(arguments)[ const]: keep the qualified name
+    int level = 0;
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < name.size(); i++)
+    {
+        if (level == 0 && name[i] == ' ')
+        {
+            start = i + 1;
+        }
+        else if (level == 0 && name[i] == '(' && i > start)
+        {
+            return name.substr(start, i - start);
+        }
+        level += name[i] == '<' || name[i] == '(' ? 1 : 0;
+        level -= name[i] == '>' || name[i] == ')' ? 1 : 0;
+    }
+    return name.substr(start);
+}
+
+inline std::string ProfilingSimulatorImpl::GetTargetName(const std::string &type)
+{
+    std::string name = type;
+    for (std::size_t pos = name.find("ns3::"); pos != std::string::npos; pos = name.find("ns3::"))
+    {
+        name.erase(pos, 5);
+    }
+    // MakeEvent<target type, object, arguments...>(...)::EventMemberImpl: keep the target type
+    std::size_t open = name.find('<');
+    if (name.compare(0, 9, "MakeEvent") != 0 || open == std::string::npos)
+    {
+        return name;
+    }
+    int level = 0;
+    for (std::size_t i = open + 1; i < name.size(); i++)
+    {
+        level += name[i] == '<' || name[i] == '(' ? 1 : 0;
+        level -= name[i] == '>' || name[i] == ')' ? 1 : 0;
+        if (level < 0 || (level == 0 && name[i] == ','))
+        {
+            return name.substr(open + 1, i - open - 1);
+        }
+    }
+    return name;
+}
+
+inline EventId ProfilingSimulatorImpl::Schedule(const Time &delay, EventImpl *event)
+{
+    return DefaultSimulatorImpl::Schedule(delay, Wrap(event));
+}
+
+inline void ProfilingSimulatorImpl::ScheduleWithContext(uint32_t context,
+                                                        const Time &delay,
+                                                        EventImpl *event)
+{
+    DefaultSimulatorImpl::ScheduleWithContext(context, delay, Wrap(event));
+}
+
+inline EventId ProfilingSimulatorImpl::ScheduleNow(EventImpl *event)
+{
+    return DefaultSimulatorImpl::ScheduleNow(Wrap(event));
+}
+
+inline bool ProfilingSimulatorImpl::IsProfiledPending(const EventId &id)
+{
+    // Cancelled and executed events are expired, and already left the count. Destroy events
+    // are not wrapped, and never entered it
+    return !IsExpired(id) && dynamic_cast<ProfiledEvent *>(id.PeekEventImpl()) != nullptr;
+}
+
+inline void ProfilingSimulatorImpl::Remove(const EventId &id)
+{
+    if (IsProfiledPending(id))
+    {
+        m_pending--;
+    }
+    DefaultSimulatorImpl::Remove(id);
+}
+
+inline void ProfilingSimulatorImpl::Cancel(const EventId &id)
+{
+    if (IsProfiledPending(id))
+    {
+        m_pending--;
+    }
+    DefaultSimulatorImpl::Cancel(id);
+}
+
+inline void ProfilingSimulatorImpl::Run()
+{
+    auto start = std::chrono::steady_clock::now();
+    DefaultSimulatorImpl::Run();
+    m_runNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+}
+
+inline void ProfilingSimulatorImpl::Destroy()
+{
+    DefaultSimulatorImpl::Destroy();
+    WriteReport();
+}
+
+inline void ProfilingSimulatorImpl::WriteReport() const
+{
+    std::vector<const Target *> sorted;
+    uint64_t eventsNs = 0;
+    uint64_t events = 0;
+    for (const auto &target : m_targets)
+    {
+        sorted.push_back(&target);
+        eventsNs += target.totalNs;
+        events += target.count;
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Target *a, const Target *b) {
+        return a->totalNs > b->totalNs;
+    });
+
+    std::ofstream report(m_reportFile);
+    NS_ABORT_MSG_IF(!report, "Cannot write profile " << m_reportFile);
+    report << std::fixed << std::setprecision(3);
+    uint64_t schedulerNs =
+        m_runNs > eventsNs + m_profilerNs ? m_runNs - eventsNs - m_profilerNs : 0;
+    report << "Run " << m_runNs * 1e-6 << " ms, events " << eventsNs * 1e-6 << " ms, scheduler "
+           << schedulerNs * 1e-6 << " ms, profiler " << m_profilerNs * 1e-6 << " ms, " << events
+           << " events\n\n";
+    report << std::setw(12) << "total ms" << std::setw(8) << "%" << std::setw(12) << "count"
+           << std::setw(12) << "mean us" << std::setw(12) << "max us" << std::setw(12)
+           << "mean depth" << std::setw(12) << "max depth"
+           << "  target < scheduled by\n";
+    for (const Target *target : sorted)
+    {
+        if (target->count == 0)
+        {
+            continue;
+        }
+        report << std::setw(12) << target->totalNs * 1e-6 << std::setw(8)
+               << (eventsNs ? 100.0 * target->totalNs / eventsNs : 0) << std::setw(12)
+               << target->count << std::setw(12) << target->totalNs * 1e-3 / target->count
+               << std::setw(12) << target->maxNs * 1e-3 << std::setw(12)
+               << static_cast<double>(target->depthSum) / target->count << std::setw(12)
+               << target->maxDepth << "  " << target->name << " < " << target->site << "\n";
+    }
+
+    // flamegraph.pl reads "frame;frame value" lines, frames must not contain ';'
+    std::ofstream folded(m_reportFile + ".folded");
+    for (const Target *target : sorted)
+    {
+        std::string site = target->site;
+        std::string name = target->name;
+        std::replace(site.begin(), site.end(), ';', ',');
+        std::replace(name.begin(), name.end(), ';', ',');
+        if (target->totalNs / 1000 > 0)
+        {
+            folded << "Simulator::Run;" << site << ";" << name << " " << target->totalNs / 1000 << "\n";
+        }
+    }
+    if (schedulerNs / 1000 > 0)
+    {
+        folded << "Simulator::Run;scheduler " << schedulerNs / 1000 << "\n";
+    }
+    if (m_profilerNs / 1000 > 0)
+    {
+        folded << "Simulator::Run;profiler " << m_profilerNs / 1000 << "\n";
+    }
+}
+
+} // namespace ns3
+
+#endif /* EVENT_PROFILER_H */
@@ -0,0 +1,58 @@
+#ifndef FLOW_METRICS_H
+#define FLOW_METRICS_H
+
+#include "ns3/flow-monitor-helper.h"
+#include "ns3/ipv4-flow-classifier.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Append the throughput, mean delay and loss ratio of every flow seen by a monitor.
+ *
+ * The metrics of a flow are named after its id and its addresses, e.g.
+ * "flow 1 (14.14.14.1 > 192.168.2.2) throughput [Mbps]". Flow ids follow the
+ * order in which the flows are first seen, so they name the same flows in
+ * every replication of a scenario. Flows without a received packet only get
+ * their loss ratio.
+ *
+ * \param helper The helper that installed the monitor, before Simulator::Destroy().
+ * \param names The metric names, appended to.
+ * \param values The metric values, appended to.
+ */
+inline void CollectFlowMetrics(FlowMonitorHelper &helper,
+                               std::vector<std::string> &names,
+                               std::vector<double> &values)
+{
+    Ptr<FlowMonitor> monitor = helper.GetMonitor();
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(helper.GetClassifier());
+    monitor->CheckForLostPackets();
+    for (const auto &flow : monitor->GetFlowStats())
+    {
+        const FlowMonitor::FlowStats &stats = flow.second;
+        Ipv4FlowClassifier::FiveTuple tuple = classifier->FindFlow(flow.first);
+        std::ostringstream prefix;
+        prefix << "flow " << flow.first << " (" << tuple.sourceAddress << " > "
+               << tuple.destinationAddress << ") ";
+
+        if (stats.rxPackets > 0)
+        {
+            double duration = (stats.timeLastRxPacket - stats.timeFirstTxPacket).GetSeconds();
+            names.push_back(prefix.str() + "throughput [Mbps]");
+            values.push_back(duration > 0 ? stats.rxBytes * 8 / duration / 1e6 : 0);
+            names.push_back(prefix.str() + "delay [ms]");
+            values.push_back(stats.delaySum.GetSeconds() * 1e3 / stats.rxPackets);
+        }
+        names.push_back(prefix.str() + "loss ratio");
+        values.push_back(stats.txPackets > 0 ? static_cast<double>(stats.lostPackets) / stats.txPackets
+                                             : 0);
+    }
+}
+
+} // namespace ns3
+
+#endif /* FLOW_METRICS_H */
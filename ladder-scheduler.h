@@ -0,0 +1,344 @@
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include "ns3/abort.h"
+#include "ns3/global-value.h"
+#include "ns3/scheduler.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Ladder queue event scheduler.
+ *
+ * The ladder queue of Tang, Goh and Thng (ACM TOMACS, 2005) inserts and
+ * removes events in O(1) amortized time, where the map and heap schedulers
+ * take O(log n). It has three tiers:
+ *
+ * - Top: the unsorted events later than the ladder.
+ * - Ladder: rungs of buckets of unsorted events. The first rung spreads the
+ *   top events over about as many buckets as there are events, and each
+ *   following rung spreads a bucket of the rung above that holds more than
+ *   BucketThreshold events.
+ * - Bottom: the first non-empty bucket, sorted, from which events are
+ *   dequeued.
+ *
+ * An event is appended to the top or to the bucket covering its time, and is
+ * only sorted once its bucket reaches the bottom. Near-future events, such as
+ * the ones scheduled by each packet transmission, land in the bottom, which is
+ * spread into a new rung when it grows past BucketThreshold.
+ *
+ * Events are ordered by time then uid, like with the other schedulers.
+ */
+class LadderScheduler : public Scheduler
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    LadderScheduler();
+
+    void Insert(const Event &ev) override;
+    bool IsEmpty() const override;
+    Event PeekNext() const override;
+    Event RemoveNext() override;
+    void Remove(const Event &ev) override;
+
+  private:
+    /// Buckets of equal width covering a time interval
+    struct Rung
+    {
+        uint64_t start;                          ///< Start of the first bucket
+        uint64_t width;                          ///< Bucket width
+        std::vector<std::vector<Event>> buckets; ///< Unsorted events of each bucket
+        std::size_t current;                     ///< First bucket not dequeued yet
+        std::size_t count;                       ///< Events left in the buckets
+    };
+
+    /**
+     * \param rung A rung.
+     * \return The start of the first bucket of the rung not dequeued yet.
+     */
+    static uint64_t GetBoundary(const Rung &rung);
+    /**
+     * \param a An event.
+     * \param b Another event.
+     * \return Whether a comes after b, the order of the bottom.
+     */
+    static bool IsLater(const Event &a, const Event &b);
+
+    /**
+     * Add a rung spreading events over about as many buckets.
+     *
+     * \param start Start of the interval covered by the rung.
+     * \param span Length of the interval, every event must fall within it.
+     * \param events The events, moved to the rung.
+     */
+    void Spawn(uint64_t start, uint64_t span, std::vector<Event> &events);
+    /// Spread the bottom into a new rung if it grew too large and can be split
+    void SpreadBottom();
+    /// Move the next events to the bottom, which is empty only if the scheduler is
+    void Refill();
+
+    uint32_t m_threshold;        //!< Events of a bucket above which it is spread
+    uint32_t m_maxRungs;         //!< Most rungs in the ladder
+    std::vector<Event> m_top;    //!< Unsorted events from m_topStart on
+    uint64_t m_topStart;         //!< Time from which events go to the top
+    uint64_t m_topMin;           //!< Earliest time in the top
+    uint64_t m_topMax;           //!< Latest time in the top
+    std::vector<Rung> m_rungs;   //!< Ladder, from the coarsest to the finest rung
+    std::vector<Event> m_bottom; //!< Next events, sorted from the last to the first
+};
+
+/**
+ * \brief Select the scheduler of the simulator.
+ *
+ * The scheduler type is bound as a global value, which leaves the simulator
+ * implementation (distributed, profiling) open until the simulator is first
+ * used.
+ *
+ * \param name map, heap, list, calendar or ladder.
+ */
+inline void SetSchedulerType(const std::string &name)
+{
+    static const std::map<std::string, std::string> types = {
+        {"map", "ns3::MapScheduler"},
+        {"heap", "ns3::HeapScheduler"},
+        {"list", "ns3::ListScheduler"},
+        {"calendar", "ns3::CalendarScheduler"},
+        {"ladder", "ns3::LadderScheduler"},
+    };
+    auto type = types.find(name);
+    NS_ABORT_MSG_IF(type == types.end(),
+                    "Unknown scheduler " << name << ", use map, heap, list, calendar or ladder");
+    GlobalValue::Bind("SchedulerType", StringValue(type->second));
+}
+
+NS_OBJECT_ENSURE_REGISTERED(LadderScheduler);
+
+inline TypeId LadderScheduler::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LadderScheduler")
+                            .SetParent<Scheduler>()
+                            .SetGroupName("Core")
+                            .AddConstructor<LadderScheduler>()
+                            .AddAttribute("BucketThreshold",
+                                          "Events of a bucket above which it is spread in a new rung",
+                                          UintegerValue(50),
+                                          MakeUintegerAccessor(&LadderScheduler::m_threshold),
+                                          MakeUintegerChecker<uint32_t>(1))
+                            .AddAttribute("MaxRungs",
+                                          "Most rungs in the ladder",
+                                          UintegerValue(8),
+                                          MakeUintegerAccessor(&LadderScheduler::m_maxRungs),
+                                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+}
+
+inline LadderScheduler::LadderScheduler()
+    : m_threshold(50),
+      m_maxRungs(8),
+      m_topStart(0),
+      m_topMin(UINT64_MAX),
+      m_topMax(0)
+{
+}
+
+inline uint64_t LadderScheduler::GetBoundary(const Rung &rung)
+{
+    return rung.start + rung.current * rung.width;
+}
+
+inline bool LadderScheduler::IsLater(const Event &a, const Event &b)
+{
+    return b.key < a.key;
+}
+
+inline void LadderScheduler::Insert(const Event &ev)
+{
+    uint64_t ts = ev.key.m_ts;
+    if (ts >= m_topStart)
+    {
+        m_top.push_back(ev);
+        m_topMin = std::min(m_topMin, ts);
+        m_topMax = std::max(m_topMax, ts);
+    }
+    else
+    {
+        // Each rung covers the dequeued part of the rung above
+        auto rung = std::find_if(m_rungs.begin(), m_rungs.end(), [ts](const Rung &r) {
+            return ts >= GetBoundary(r);
+        });
+        if (rung != m_rungs.end())
+        {
+            rung->buckets[(ts - rung->start) / rung->width].push_back(ev);
+            rung->count++;
+        }
+        else
+        {
+            m_bottom.insert(std::upper_bound(m_bottom.begin(), m_bottom.end(), ev, IsLater), ev);
+            SpreadBottom();
+        }
+    }
+    Refill();
+}
+
+inline bool LadderScheduler::IsEmpty() const
+{
+    return m_bottom.empty();
+}
+
+inline Scheduler::Event LadderScheduler::PeekNext() const
+{
+    NS_ABORT_MSG_IF(m_bottom.empty(), "No event scheduled");
+    return m_bottom.back();
+}
+
+inline Scheduler::Event LadderScheduler::RemoveNext()
+{
+    NS_ABORT_MSG_IF(m_bottom.empty(), "No event scheduled");
+    Event ev = m_bottom.back();
+    m_bottom.pop_back();
+    Refill();
+    return ev;
+}
+
+inline void LadderScheduler::Remove(const Event &ev)
+{
+    uint64_t ts = ev.key.m_ts;
+    auto isEvent = [&ev](const Event &e) { return e.key.m_uid == ev.key.m_uid; };
+    if (ts >= m_topStart)
+    {
+        // The top bounds are left as they are, they still hold every event
+        auto it = std::find_if(m_top.begin(), m_top.end(), isEvent);
+        NS_ABORT_MSG_IF(it == m_top.end(), "Event " << ev.key.m_uid << " not scheduled");
+        *it = m_top.back();
+        m_top.pop_back();
+    }
+    else
+    {
+        auto rung = std::find_if(m_rungs.begin(), m_rungs.end(), [ts](const Rung &r) {
+            return ts >= GetBoundary(r);
+        });
+        if (rung != m_rungs.end())
+        {
+            std::vector<Event> &bucket = rung->buckets[(ts - rung->start) / rung->width];
+            auto it = std::find_if(bucket.begin(), bucket.end(), isEvent);
+            NS_ABORT_MSG_IF(it == bucket.end(), "Event " << ev.key.m_uid << " not scheduled");
+            *it = bucket.back();
+            bucket.pop_back();
+            rung->count--;
+        }
+        else
+        {
+            auto it = std::lower_bound(m_bottom.begin(), m_bottom.end(), ev, IsLater);
+            NS_ABORT_MSG_IF(it == m_bottom.end() || !isEvent(*it),
+                            "Event " << ev.key.m_uid << " not scheduled");
+            m_bottom.erase(it);
+        }
+    }
+    Refill();
+}
+
+inline void LadderScheduler::Spawn(uint64_t start, uint64_t span, std::vector<Event> &events)
+{
+    Rung rung;
+    rung.start = start;
+    rung.width = (span - 1) / events.size() + 1;
+    rung.buckets.resize((span - 1) / rung.width + 1);
+    rung.current = 0;
+    rung.count = events.size();
+    for (const auto &ev : events)
+    {
+        rung.buckets[(ev.key.m_ts - start) / rung.width].push_back(ev);
+    }
+    events.clear();
+    m_rungs.push_back(std::move(rung));
+}
+
+inline void LadderScheduler::SpreadBottom()
+{
+    if (m_bottom.size() <= m_threshold || m_rungs.size() >= m_maxRungs ||
+        m_bottom.front().key.m_ts == m_bottom.back().key.m_ts)
+    {
+        return;
+    }
+    // The bottom holds the events before the first boundary of the ladder
+    uint64_t end = m_topStart;
+    for (const auto &rung : m_rungs)
+    {
+        end = std::min(end, GetBoundary(rung));
+    }
+    uint64_t start = m_bottom.back().key.m_ts;
+    Spawn(start, end - start, m_bottom);
+}
+
+inline void LadderScheduler::Refill()
+{
+    while (m_bottom.empty())
+    {
+        if (m_rungs.empty())
+        {
+            if (m_top.empty())
+            {
+                return;
+            }
+            if (m_top.size() <= m_threshold || m_topMin == m_topMax)
+            {
+                m_bottom.swap(m_top);
+                std::sort(m_bottom.begin(), m_bottom.end(), IsLater);
+                m_topStart = m_topMax + 1;
+            }
+            else
+            {
+                Spawn(m_topMin, m_topMax - m_topMin + 1, m_top);
+                const Rung &rung = m_rungs.back();
+                m_topStart = rung.start + rung.buckets.size() * rung.width;
+            }
+            m_topMin = UINT64_MAX;
+            m_topMax = 0;
+            continue;
+        }
+
+        Rung &rung = m_rungs.back();
+        if (rung.count == 0)
+        {
+            m_rungs.pop_back();
+            continue;
+        }
+        while (rung.buckets[rung.current].empty())
+        {
+            rung.current++;
+        }
+        std::vector<Event> events;
+        events.swap(rung.buckets[rung.current]);
+        uint64_t start = GetBoundary(rung);
+        uint64_t width = rung.width;
+        rung.current++;
+        rung.count -= events.size();
+        if (events.size() > m_threshold && width > 1 && m_rungs.size() < m_maxRungs)
+        {
+            Spawn(start, width, events);
+        }
+        else
+        {
+            m_bottom.swap(events);
+            std::sort(m_bottom.begin(), m_bottom.end(), IsLater);
+        }
+    }
+}
+
+} // namespace ns3
+
+#endif /* LADDER_SCHEDULER_H */
@@ -0,0 +1,63 @@
+#include "ns3/command-line.h"
+
+#include "async-log.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace ns3;
+
+/*
+ * Format a binary log written by AsyncLog (e.g. TFE-topology-TCP.nslog, with
+ * --logSink=async) as text, one line per record prefixed with the simulation
+ * time and the context (node id) of the record.
+ *
+ *   ./ns3 run "log-format --input=TFE-topology-TCP.nslog --output=TFE-topology-TCP.log"
+ */
+
+int main(int argc, char *argv[])
+{
+    std::string input = "";
+    std::string output = "";
+    bool prefix = true;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "Log file to format", input);
+    cmd.AddValue("output", "Text file (stdout when empty)", output);
+    cmd.AddValue("prefix", "Prefix each line with its time [s] and context", prefix);
+    cmd.Parse(argc, argv);
+
+    AsyncLogReader reader;
+    if (!reader.Open(input))
+    {
+        std::cerr << "Cannot read log file " << input << std::endl;
+        return 1;
+    }
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+    }
+    std::ostream &out = output.empty() ? std::cout : file;
+
+    int64_t timeNs;
+    uint32_t context;
+    std::string line;
+    while (reader.Read(timeNs, context, line))
+    {
+        if (prefix)
+        {
+            out << "+" << timeNs * 1e-9 << "s ";
+            if (context == 0xffffffff)
+            {
+                out << "- ";
+            }
+            else
+            {
+                out << context << " ";
+            }
+        }
+        out << line << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "ns3/command-line.h"
+#include "ns3/gnuplot.h"
+
+#include "metrics-sink.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace ns3;
+
+/*
+ * Export a metrics file written by MetricsSink (e.g. metrics-parf.nsm from
+ * researchCase) as CSV, or as a Gnuplot file plotting one column against another.
+ *
+ *   ./ns3 run "metrics-export --input=metrics-parf.nsm --output=parf.csv"
+ *   ./ns3 run "metrics-export --input=metrics-parf.nsm --format=gnuplot
+ *              --x=distance --y=throughput --output=throughput-parf.plt"
+ */
+
+int main(int argc, char *argv[])
+{
+    std::string input = "";
+    std::string output = "";
+    std::string format = "csv";
+    std::string xColumn = "distance";
+    std::string yColumn = "throughput";
+    std::string title = "";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "Metrics file to export", input);
+    cmd.AddValue("output", "Output file (CSV goes to stdout when empty)", output);
+    cmd.AddValue("format", "Output format: csv or gnuplot", format);
+    cmd.AddValue("x", "Column on the x axis (gnuplot)", xColumn);
+    cmd.AddValue("y", "Column on the y axis (gnuplot)", yColumn);
+    cmd.AddValue("title", "Plot title (gnuplot)", title);
+    cmd.Parse(argc, argv);
+
+    MetricsReader reader;
+    if (!reader.Open(input))
+    {
+        std::cerr << "Cannot read metrics file " << input << std::endl;
+        return 1;
+    }
+    std::vector<std::vector<double>> block;
+
+    if (format == "csv")
+    {
+        std::ofstream file;
+        if (!output.empty())
+        {
+            file.open(output);
+        }
+        std::ostream &out = output.empty() ? std::cout : file;
+        for (std::size_t column = 0; column < reader.GetColumns().size(); column++)
+        {
+            out << (column ? "," : "") << reader.GetColumns()[column];
+        }
+        out << std::endl;
+        while (reader.ReadBlock(block))
+        {
+            for (std::size_t row = 0; row < block[0].size(); row++)
+            {
+                for (std::size_t column = 0; column < block.size(); column++)
+                {
+                    out << (column ? "," : "") << block[column][row];
+                }
+                out << "\n";
+            }
+        }
+        return 0;
+    }
+
+    if (format == "gnuplot")
+    {
+        uint32_t x = reader.GetColumnIndex(xColumn);
+        uint32_t y = reader.GetColumnIndex(yColumn);
+        if (x == reader.GetColumns().size() || y == reader.GetColumns().size())
+        {
+            std::cerr << "Unknown column " << xColumn << " or " << yColumn << std::endl;
+            return 1;
+        }
+        Gnuplot2dDataset dataset;
+        dataset.SetTitle(title.empty() ? yColumn : title);
+        while (reader.ReadBlock(block))
+        {
+            for (std::size_t row = 0; row < block[x].size(); row++)
+            {
+                dataset.Add(block[x][row], block[y][row]);
+            }
+        }
+        std::string plotName = output.empty() ? yColumn + ".plt" : output;
+        std::ofstream outfile(plotName);
+        Gnuplot gnuplot = Gnuplot(plotName.substr(0, plotName.rfind('.')) + ".eps", title);
+        gnuplot.SetTerminal("post eps color enhanced");
+        gnuplot.SetLegend(xColumn, yColumn);
+        gnuplot.AddDataset(dataset);
+        gnuplot.GenerateOutput(outfile);
+        return 0;
+    }
+
+    std::cerr << "Unknown format " << format << std::endl;
+    return 1;
+}
@@ -0,0 +1,277 @@
+#ifndef METRICS_SINK_H
+#define METRICS_SINK_H
+
+#include "ns3/abort.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/*
+ * Metrics file layout, in host byte order:
+ *
+ *   "NSMC" | uint32 version | uint32 nColumns | nColumns x (uint32 length, name)
+ *   then any number of blocks:
+ *   uint32 nRows | nColumns x (nRows x double)
+ *
+ * Each block stores its rows column by column. A block is only written once
+ * complete, so a file cut short by a crash still holds every flushed block.
+ */
+
+/// Magic number at the start of a metrics file
+static const char metricsMagic[4] = {'N', 'S', 'M', 'C'};
+/// Version of the metrics file layout
+static const uint32_t metricsVersion = 1;
+
+/**
+ * \brief Append-only, buffered, binary columnar writer of simulation metrics.
+ *
+ * Rows are buffered column by column and written as one block on Flush(), or
+ * when maxBufferedRows rows are pending, so memory stays bounded whatever the
+ * length of the run.
+ */
+class MetricsSink
+{
+  public:
+    /// Rows kept in memory before a block is written out
+    static const uint32_t maxBufferedRows = 4096;
+
+    MetricsSink();
+    ~MetricsSink();
+
+    /**
+     * Create the file and write its header.
+     *
+     * \param fileName The metrics filename.
+     * \param columns The column names.
+     */
+    void Open(const std::string &fileName, const std::vector<std::string> &columns);
+    /**
+     * Append one row, one value per column.
+     *
+     * \param row The row values.
+     */
+    void Append(std::initializer_list<double> row);
+    /**
+     * Append the rows of a block read by MetricsReader.
+     *
+     * \param block The block values, column by column.
+     */
+    void AppendBlock(const std::vector<std::vector<double>> &block);
+    /// Write the pending rows as a block and flush the file
+    void Flush();
+    /// Flush and close the file
+    void Close();
+    /// \return True if the file is open
+    bool IsOpen() const;
+
+  private:
+    std::ofstream m_file;                     //!< Metrics file
+    std::vector<std::vector<double>> m_block; //!< Pending rows, column by column
+};
+
+/**
+ * \brief Reads back the blocks of a metrics file written by MetricsSink.
+ */
+class MetricsReader
+{
+  public:
+    /**
+     * Open a metrics file and read its header.
+     *
+     * \param fileName The metrics filename.
+     * \return False if the file cannot be read or is not a metrics file.
+     */
+    bool Open(const std::string &fileName);
+    /// \return The column names
+    const std::vector<std::string> &GetColumns() const;
+    /**
+     * \param name A column name.
+     * \return The index of the column, or the number of columns if there is none.
+     */
+    uint32_t GetColumnIndex(const std::string &name) const;
+    /**
+     * Read the next complete block.
+     *
+     * \param block Filled with the block values, column by column.
+     * \return False at the end of the file or on a truncated block.
+     */
+    bool ReadBlock(std::vector<std::vector<double>> &block);
+
+  private:
+    /**
+     * \param value Filled with the value read.
+     * \return False on a short read.
+     */
+    bool ReadU32(uint32_t &value);
+
+    std::ifstream m_file;               //!< Metrics file
+    std::vector<std::string> m_columns; //!< Column names
+};
+
+inline MetricsSink::MetricsSink()
+{
+}
+
+inline MetricsSink::~MetricsSink()
+{
+    Close();
+}
+
+inline void MetricsSink::Open(const std::string &fileName, const std::vector<std::string> &columns)
+{
+    Close();
+    m_file.open(fileName, std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_file, "Cannot open metrics file " << fileName);
+    uint32_t nColumns = columns.size();
+    m_file.write(metricsMagic, sizeof(metricsMagic));
+    m_file.write(reinterpret_cast<const char *>(&metricsVersion), sizeof(metricsVersion));
+    m_file.write(reinterpret_cast<const char *>(&nColumns), sizeof(nColumns));
+    for (const auto &column : columns)
+    {
+        uint32_t length = column.size();
+        m_file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+        m_file.write(column.data(), length);
+    }
+    m_file.flush();
+    m_block.assign(nColumns, std::vector<double>());
+    for (auto &column : m_block)
+    {
+        column.reserve(maxBufferedRows);
+    }
+}
+
+inline void MetricsSink::Append(std::initializer_list<double> row)
+{
+    NS_ASSERT_MSG(row.size() == m_block.size(), "Row does not match the metrics columns");
+    uint32_t column = 0;
+    for (double value : row)
+    {
+        m_block[column++].push_back(value);
+    }
+    if (m_block[0].size() >= maxBufferedRows)
+    {
+        Flush();
+    }
+}
+
+inline void MetricsSink::AppendBlock(const std::vector<std::vector<double>> &block)
+{
+    NS_ASSERT_MSG(block.size() == m_block.size(), "Block does not match the metrics columns");
+    for (uint32_t column = 0; column < block.size(); column++)
+    {
+        m_block[column].insert(m_block[column].end(), block[column].begin(), block[column].end());
+    }
+    if (m_block[0].size() >= maxBufferedRows)
+    {
+        Flush();
+    }
+}
+
+inline void MetricsSink::Flush()
+{
+    if (!m_file.is_open() || m_block.empty() || m_block[0].empty())
+    {
+        return;
+    }
+    uint32_t nRows = m_block[0].size();
+    m_file.write(reinterpret_cast<const char *>(&nRows), sizeof(nRows));
+    for (auto &column : m_block)
+    {
+        m_file.write(reinterpret_cast<const char *>(column.data()), nRows * sizeof(double));
+        column.clear();
+    }
+    m_file.flush();
+}
+
+inline void MetricsSink::Close()
+{
+    if (m_file.is_open())
+    {
+        Flush();
+        m_file.close();
+    }
+}
+
+inline bool MetricsSink::IsOpen() const
+{
+    return m_file.is_open();
+}
+
+inline bool MetricsReader::ReadU32(uint32_t &value)
+{
+    m_file.read(reinterpret_cast<char *>(&value), sizeof(value));
+    return m_file.gcount() == sizeof(value);
+}
+
+inline bool MetricsReader::Open(const std::string &fileName)
+{
+    m_file.open(fileName, std::ios::binary);
+    char magic[sizeof(metricsMagic)];
+    m_file.read(magic, sizeof(magic));
+    uint32_t version;
+    uint32_t nColumns;
+    if (!m_file || std::memcmp(magic, metricsMagic, sizeof(magic)) != 0 || !ReadU32(version) ||
+        version != metricsVersion || !ReadU32(nColumns))
+    {
+        return false;
+    }
+    m_columns.clear();
+    for (uint32_t i = 0; i < nColumns; i++)
+    {
+        uint32_t length;
+        if (!ReadU32(length))
+        {
+            return false;
+        }
+        std::string name(length, '\0');
+        m_file.read(&name[0], length);
+        m_columns.push_back(name);
+    }
+    return static_cast<bool>(m_file);
+}
+
+inline const std::vector<std::string> &MetricsReader::GetColumns() const
+{
+    return m_columns;
+}
+
+inline uint32_t MetricsReader::GetColumnIndex(const std::string &name) const
+{
+    uint32_t index = 0;
+    while (index < m_columns.size() && m_columns[index] != name)
+    {
+        index++;
+    }
+    return index;
+}
+
+inline bool MetricsReader::ReadBlock(std::vector<std::vector<double>> &block)
+{
+    uint32_t nRows;
+    if (!ReadU32(nRows))
+    {
+        return false;
+    }
+    block.resize(m_columns.size());
+    for (auto &column : block)
+    {
+        column.resize(nRows);
+        m_file.read(reinterpret_cast<char *>(column.data()), nRows * sizeof(double));
+        if (m_file.gcount() != static_cast<std::streamsize>(nRows * sizeof(double)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace ns3
+
+#endif /* METRICS_SINK_H */
@@ -0,0 +1,284 @@
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include "ns3/abort.h"
+#include "ns3/data-rate.h"
+#include "ns3/mac48-address.h"
+#include "ns3/packet.h"
+#include "ns3/pcap-file-wrapper.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-helper.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Bounded capture of the frames sent on a wifi channel.
+ *
+ * Frames are taken from PhyTxBegin, so every frame on the channel is written
+ * once, and saved as DLT_IEEE802_11 pcap truncated to the snap length:
+ *
+ * - off: nothing is captured.
+ * - header: every frame, truncated to the snap length.
+ * - sampled: one frame in sampleN, truncated to the snap length.
+ * - ring: the last ringSize frames are kept in memory and only written out
+ *   when a trigger fires, a rate change or a throughput sample below the
+ *   trigger threshold. The ring is emptied by every dump. Managers such as
+ *   Minstrel or Parf change rate nearly all the time, so a rate change only
+ *   dumps the ring once the dump gap has elapsed since its previous dump.
+ *
+ * The ring takes ringSize x snapLen bytes, allocated once by Setup().
+ */
+class PacketCapture
+{
+  public:
+    /// Capture level
+    enum Mode
+    {
+        OFF,
+        HEADER,
+        SAMPLED,
+        RING
+    };
+
+    /**
+     * \param name A capture level name: off, header, sampled or ring.
+     * \return The capture level.
+     */
+    static Mode GetMode(const std::string &name);
+
+    PacketCapture();
+
+    /**
+     * Set the capture level and create the capture file if frames are written
+     * as they are sent.
+     *
+     * \param mode The capture level.
+     * \param prefix The capture filename, without the .pcap extension.
+     * \param snapLen Bytes kept per frame.
+     * \param sampleN Frames per sampled frame, in sampled mode.
+     * \param ringSize Frames kept in memory, in ring mode.
+     * \param triggerMbps Throughput below which the ring is dumped, 0 disables.
+     * \param dumpGap Least time between two dumps on a rate change, in ring mode.
+     */
+    void Setup(Mode mode,
+               const std::string &prefix,
+               uint32_t snapLen,
+               uint32_t sampleN,
+               uint32_t ringSize,
+               double triggerMbps,
+               Time dumpGap);
+    /// \return The capture level
+    Mode GetMode() const;
+
+    /**
+     * Callback called by WifiNetDevice/Phy/PhyTxBegin.
+     *
+     * \param packet The frame sent.
+     * \param powerW The transmit power [W].
+     */
+    void PhyCallback(Ptr<const Packet> packet, double powerW);
+    /**
+     * Callback called by WifiNetDevice/RemoteStationManager/x/RateChange,
+     * dumps the ring unless the previous rate change dump is more recent than
+     * the dump gap.
+     *
+     * \param path The trace path.
+     * \param oldRate Old rate.
+     * \param newRate Actual rate.
+     * \param dest Destination of the transmission.
+     */
+    void RateCallback(std::string path, DataRate oldRate, DataRate newRate, Mac48Address dest);
+    /**
+     * Dumps the ring if the throughput is below the trigger threshold.
+     *
+     * \param mbs A throughput sample [Mbps].
+     */
+    void ThroughputCallback(double mbs);
+    /// Write the frames held by the ring and empty it
+    void Dump();
+
+  private:
+    /// Frame held by the ring, its bytes are in m_ringBytes
+    struct RingEntry
+    {
+        Time time;       ///< Transmission time
+        uint32_t length; ///< Length of the whole frame
+    };
+
+    /// Create the capture file if it is not open yet
+    void OpenFile();
+
+    Mode m_mode;
+    std::string m_fileName;
+    uint32_t m_snapLen;
+    uint32_t m_sampleN;
+    double m_triggerMbps;
+    Time m_dumpGap;      //!< Least time between two dumps on a rate change
+    Time m_nextRateDump; //!< Earliest dump on a rate change
+    uint64_t m_count;    //!< Frames seen
+    Ptr<PcapFileWrapper> m_file;
+
+    std::vector<RingEntry> m_ring;
+    std::vector<uint8_t> m_ringBytes; //!< snapLen bytes per ring entry
+    uint32_t m_ringNext;              //!< Entry written by the next frame
+    uint32_t m_ringUsed;              //!< Entries holding a frame
+};
+
+inline PacketCapture::Mode PacketCapture::GetMode(const std::string &name)
+{
+    if (name == "off")
+    {
+        return OFF;
+    }
+    if (name == "header")
+    {
+        return HEADER;
+    }
+    if (name == "sampled")
+    {
+        return SAMPLED;
+    }
+    if (name == "ring")
+    {
+        return RING;
+    }
+    NS_ABORT_MSG("Unknown capture level \"" << name << "\", use off, header, sampled or ring");
+    return OFF;
+}
+
+inline PacketCapture::PacketCapture()
+    : m_mode(OFF),
+      m_snapLen(0),
+      m_sampleN(1),
+      m_triggerMbps(0),
+      m_count(0),
+      m_ringNext(0),
+      m_ringUsed(0)
+{
+}
+
+inline void PacketCapture::Setup(Mode mode,
+                                 const std::string &prefix,
+                                 uint32_t snapLen,
+                                 uint32_t sampleN,
+                                 uint32_t ringSize,
+                                 double triggerMbps,
+                                 Time dumpGap)
+{
+    NS_ABORT_MSG_IF(mode != OFF && snapLen == 0, "The capture snap length must not be 0");
+    NS_ABORT_MSG_IF(mode == SAMPLED && sampleN == 0, "The capture sample rate must not be 0");
+    NS_ABORT_MSG_IF(mode == RING && ringSize == 0, "The capture ring size must not be 0");
+    m_mode = mode;
+    m_fileName = prefix + ".pcap";
+    m_snapLen = snapLen;
+    m_sampleN = sampleN;
+    m_triggerMbps = triggerMbps;
+    m_dumpGap = dumpGap;
+    m_nextRateDump = Simulator::Now();
+    m_count = 0;
+    m_ringNext = 0;
+    m_ringUsed = 0;
+    if (m_mode == RING)
+    {
+        m_ring.assign(ringSize, RingEntry());
+        m_ringBytes.assign(static_cast<std::size_t>(ringSize) * snapLen, 0);
+    }
+    else if (m_mode != OFF)
+    {
+        OpenFile();
+    }
+}
+
+inline PacketCapture::Mode PacketCapture::GetMode() const
+{
+    return m_mode;
+}
+
+inline void PacketCapture::OpenFile()
+{
+    if (!m_file)
+    {
+        PcapHelper pcapHelper;
+        m_file = pcapHelper.CreateFile(m_fileName,
+                                       std::ios::out,
+                                       PcapHelper::DLT_IEEE802_11,
+                                       m_snapLen);
+    }
+}
+
+inline void PacketCapture::PhyCallback(Ptr<const Packet> packet, double powerW)
+{
+    switch (m_mode)
+    {
+    case OFF:
+        break;
+    case SAMPLED:
+        if (m_count++ % m_sampleN != 0)
+        {
+            break;
+        }
+        [[fallthrough]];
+    case HEADER:
+        // The file drops the bytes past its snap length
+        m_file->Write(Simulator::Now(), packet);
+        break;
+    case RING: {
+        RingEntry &entry = m_ring[m_ringNext];
+        entry.time = Simulator::Now();
+        entry.length = packet->GetSize();
+        packet->CopyData(&m_ringBytes[static_cast<std::size_t>(m_ringNext) * m_snapLen],
+                         std::min(entry.length, m_snapLen));
+        m_ringNext = (m_ringNext + 1) % m_ring.size();
+        m_ringUsed = std::min<uint32_t>(m_ringUsed + 1, m_ring.size());
+        break;
+    }
+    }
+}
+
+inline void PacketCapture::RateCallback(std::string path,
+                                        DataRate oldRate,
+                                        DataRate newRate,
+                                        Mac48Address dest)
+{
+    if (Simulator::Now() >= m_nextRateDump)
+    {
+        Dump();
+        m_nextRateDump = Simulator::Now() + m_dumpGap;
+    }
+}
+
+inline void PacketCapture::ThroughputCallback(double mbs)
+{
+    if (mbs < m_triggerMbps)
+    {
+        Dump();
+    }
+}
+
+inline void PacketCapture::Dump()
+{
+    if (m_mode != RING || m_ringUsed == 0)
+    {
+        return;
+    }
+    OpenFile();
+    uint32_t entry = (m_ringNext + m_ring.size() - m_ringUsed) % m_ring.size();
+    for (uint32_t i = 0; i < m_ringUsed; i++)
+    {
+        // Given the whole frame length, the file only reads the snap length bytes kept
+        m_file->Write(m_ring[entry].time,
+                      &m_ringBytes[static_cast<std::size_t>(entry) * m_snapLen],
+                      m_ring[entry].length);
+        entry = (entry + 1) % m_ring.size();
+    }
+    m_ringUsed = 0;
+}
+
+} // namespace ns3
+
+#endif /* PACKET_CAPTURE_H */
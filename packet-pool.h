@@ -0,0 +1,300 @@
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+#include <sstream>
+
+namespace ns3
+{
+
+/**
+ * \brief Thread-local slab pools behind the global operator new and delete.
+ *
+ * ns-3 allocates every Packet, its Buffer data, tags and metadata, and every
+ * scheduled event with new, so under saturated traffic malloc and free take a
+ * large share of the run. Once enabled, allocations of up to 4096 bytes are
+ * served from the free list of their size class, refilled from 64 kB slabs.
+ * The blocks freed when packets reach their sink are reused by the next
+ * packets, and the heap is only called while the packets in flight grow.
+ *
+ * Pools belong to a thread and take no lock. A block freed by another thread
+ * joins the pool of that thread. Slabs are never returned to the heap.
+ *
+ * Each block starts with a 16-byte header holding its size class, for delete
+ * to find its pool. Blocks allocated while the pools are disabled, or larger
+ * than 4096 bytes, come from malloc and go back to free.
+ *
+ * The global operator new and delete are only replaced when the program is
+ * built with PACKET_POOL_REPLACE_NEW defined, e.g. with
+ * CXXFLAGS=-DPACKET_POOL_REPLACE_NEW at ns-3 configure time. The header must
+ * then be included in a single translation unit of the program. Without it,
+ * every allocation goes straight to the default operator new and the pools
+ * cannot be enabled, so that the unpooled runs of a comparison pay for no
+ * header nor counter.
+ */
+class PacketPool
+{
+  public:
+    /// Allocation counters of a thread
+    struct Stats
+    {
+        uint64_t allocations; ///< Calls to operator new
+        uint64_t pooled;      ///< Allocations served by a size class
+        uint64_t reused;      ///< Pooled allocations served by a freed block
+        uint64_t slabs;       ///< Slabs allocated from the heap
+    };
+
+    /**
+     * Serve the next allocations from the pools, or from malloc.
+     *
+     * \param enabled Whether the pools are used.
+     */
+    static void Enable(bool enabled = true);
+    /// \return Whether the pools are used
+    static bool IsEnabled();
+    /// \return Whether the program replaces operator new with the pools
+    static bool IsAvailable();
+
+    /// \return The allocation counters of the calling thread
+    static Stats GetStats();
+    /// Reset the allocation counters of the calling thread
+    static void ResetStats();
+    /**
+     * Print the allocation counters of the calling thread on one line.
+     *
+     * \param os The output stream.
+     */
+    static void PrintStats(std::ostream &os);
+
+    /**
+     * \param size The requested size [bytes].
+     * \return The block, nullptr when out of memory.
+     */
+    static void *Allocate(std::size_t size);
+    /**
+     * \param block A block returned by Allocate(), or nullptr.
+     */
+    static void Deallocate(void *block);
+
+  private:
+    static const uint32_t N_CLASSES = 16;        //!< Number of size classes
+    static const std::size_t MAX_SIZE = 4096;    //!< Largest pooled size [bytes]
+    static const std::size_t SLAB_SIZE = 65536;  //!< Slab size [bytes]
+    static const uint32_t UNPOOLED = 0xffffffff; //!< Size class of the malloc blocks
+
+    /// Prefix of every block
+    struct Header
+    {
+        uint32_t sizeClass; ///< Size class, or UNPOOLED
+        uint32_t padding;   ///< Keeps the blocks 16-byte aligned
+        Header *next;       ///< Next free block of the size class
+    };
+
+    /// Pools and counters of a thread, zero-initialized
+    struct Cache
+    {
+        Header *free[N_CLASSES]; ///< Freed blocks of each size class
+        char *cursor[N_CLASSES]; ///< Next unused block of the slab of each size class
+        char *end[N_CLASSES];    ///< End of the slab of each size class
+        Stats stats;             ///< Allocation counters
+    };
+
+    /**
+     * \param size A requested size, at most MAX_SIZE [bytes].
+     * \return The smallest size class holding it.
+     */
+    static uint32_t GetSizeClass(std::size_t size);
+    /**
+     * \param sizeClass A size class.
+     * \return The block size of the class, header included [bytes].
+     */
+    static std::size_t GetBlockSize(uint32_t sizeClass);
+    /// \return The pools of the calling thread
+    static Cache &GetCache();
+    /// \return The flag enabling the pools
+    static bool &GetEnabled();
+};
+
+inline bool &PacketPool::GetEnabled()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+inline void PacketPool::Enable(bool enabled)
+{
+    GetEnabled() = enabled;
+}
+
+inline bool PacketPool::IsEnabled()
+{
+    return GetEnabled();
+}
+
+inline bool PacketPool::IsAvailable()
+{
+#ifdef PACKET_POOL_REPLACE_NEW
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline PacketPool::Cache &PacketPool::GetCache()
+{
+    // Trivial, so that no constructor runs in operator new
+    static thread_local Cache cache;
+    return cache;
+}
+
+inline PacketPool::Stats PacketPool::GetStats()
+{
+    return GetCache().stats;
+}
+
+inline void PacketPool::ResetStats()
+{
+    GetCache().stats = Stats();
+}
+
+inline void PacketPool::PrintStats(std::ostream &os)
+{
+    Stats stats = GetStats();
+    double allocations = stats.allocations ? stats.allocations : 1;
+    std::ostringstream line;
+    line << "Allocations: " << stats.allocations << ", pooled "
+         << 100 * stats.pooled / allocations << "%, reused " << 100 * stats.reused / allocations
+         << "%, heap calls " << stats.allocations - stats.pooled + stats.slabs << ", slabs "
+         << stats.slabs * SLAB_SIZE / 1048576.0 << " MB";
+    os << line.str() << std::endl;
+}
+
+inline uint32_t PacketPool::GetSizeClass(std::size_t size)
+{
+    // 16, 32, 48, 64, then 96, 128, 192, 256, ... 3072, 4096
+    if (size <= 64)
+    {
+        return size == 0 ? 0 : (size - 1) / 16;
+    }
+    uint32_t log2 = 63 - __builtin_clzll(size - 1);
+    std::size_t lower = std::size_t(1) << log2;
+    return 2 * (log2 - 6) + (size <= lower + lower / 2 ? 4 : 5);
+}
+
+inline std::size_t PacketPool::GetBlockSize(uint32_t sizeClass)
+{
+    std::size_t size = sizeClass < 4 ? 16 * (sizeClass + 1)
+                                     : (sizeClass % 2 ? 128 : 96) << ((sizeClass - 4) / 2);
+    return sizeof(Header) + size;
+}
+
+inline void *PacketPool::Allocate(std::size_t size)
+{
+    Cache &cache = GetCache();
+    cache.stats.allocations++;
+    if (!GetEnabled() || size > MAX_SIZE)
+    {
+        Header *header = static_cast<Header *>(std::malloc(sizeof(Header) + size));
+        if (!header)
+        {
+            return nullptr;
+        }
+        header->sizeClass = UNPOOLED;
+        return header + 1;
+    }
+
+    uint32_t sizeClass = GetSizeClass(size);
+    Header *header = cache.free[sizeClass];
+    if (header)
+    {
+        cache.free[sizeClass] = header->next;
+        cache.stats.reused++;
+    }
+    else
+    {
+        std::size_t blockSize = GetBlockSize(sizeClass);
+        if (static_cast<std::size_t>(cache.end[sizeClass] - cache.cursor[sizeClass]) < blockSize)
+        {
+            // The rest of the previous slab is left unused
+            char *slab = static_cast<char *>(std::malloc(SLAB_SIZE));
+            if (!slab)
+            {
+                return nullptr;
+            }
+            cache.cursor[sizeClass] = slab;
+            cache.end[sizeClass] = slab + SLAB_SIZE;
+            cache.stats.slabs++;
+        }
+        header = reinterpret_cast<Header *>(cache.cursor[sizeClass]);
+        header->sizeClass = sizeClass;
+        cache.cursor[sizeClass] += blockSize;
+    }
+    cache.stats.pooled++;
+    return header + 1;
+}
+
+inline void PacketPool::Deallocate(void *block)
+{
+    if (!block)
+    {
+        return;
+    }
+    Header *header = static_cast<Header *>(block) - 1;
+    if (header->sizeClass == UNPOOLED)
+    {
+        std::free(header);
+        return;
+    }
+    Cache &cache = GetCache();
+    header->next = cache.free[header->sizeClass];
+    cache.free[header->sizeClass] = header;
+}
+
+} // namespace ns3
+
+#ifdef PACKET_POOL_REPLACE_NEW
+
+// Replacement functions cannot be inline, hence the single translation unit
+
+void *operator new(std::size_t size)
+{
+    void *block = ns3::PacketPool::Allocate(size);
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *block) noexcept
+{
+    ns3::PacketPool::Deallocate(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+    ns3::PacketPool::Deallocate(block);
+}
+
+void operator delete(void *block, std::size_t) noexcept
+{
+    ns3::PacketPool::Deallocate(block);
+}
+
+void operator delete[](void *block, std::size_t) noexcept
+{
+    ns3::PacketPool::Deallocate(block);
+}
+
+#endif /* PACKET_POOL_REPLACE_NEW */
+
+#endif /* PACKET_POOL_H */
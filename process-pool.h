@@ -0,0 +1,250 @@
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+/**
+ * \brief Runs independent simulation jobs on a pool of worker processes.
+ *
+ * One worker process is forked per core and pinned to it. Each worker gets a
+ * share of the cores the pool inherited, e.g. from taskset or a cgroup, that
+ * GetShare() returns to its jobs so that the processes they fork spread over
+ * it rather than over the cores of the other workers. Workers pull job
+ * indices from a counter kept in anonymous shared memory, so a worker that is
+ * done early keeps taking the remaining jobs instead of idling.
+ *
+ * Every job runs in a short-lived child of its worker. ns-3 keeps global state
+ * (node list, RNG stream numbers, MAC address allocator) that is not reset by
+ * Simulator::Destroy(), and a fresh child gives the same results as a
+ * standalone run of the same job. The job result is an opaque byte string
+ * handed back to the parent through a private temporary directory.
+ */
+class ProcessPool
+{
+  public:
+    /// Job body, called in a child process with the job index
+    typedef std::function<std::string(uint32_t)> JobBody;
+
+    /**
+     * \param workers Number of worker processes, 0 to use every available core.
+     */
+    explicit ProcessPool(uint32_t workers = 0);
+
+    /**
+     * Run jobs [0, nJobs) and collect their results.
+     *
+     * \param nJobs Number of jobs.
+     * \param body Job body.
+     * \return The result of each job, indexed by job.
+     */
+    std::vector<std::string> Run(uint32_t nJobs, JobBody body);
+
+    /// \return The number of worker processes
+    uint32_t GetNWorkers() const;
+
+    /**
+     * \return The cores the processes forked by the caller may run on: the share
+     *         of its worker inside a pool, the affinity of the process otherwise.
+     */
+    static cpu_set_t GetShare();
+
+  private:
+    /// \return The share of the worker of this process, empty outside a pool
+    static cpu_set_t &GetWorkerShare();
+
+    /**
+     * Pull and run jobs until none is left. Called in a worker process.
+     *
+     * \param worker Index of the worker.
+     * \param nJobs Number of jobs.
+     * \param body Job body.
+     * \param next Shared index of the next job to run.
+     */
+    void WorkerLoop(uint32_t worker,
+                    uint32_t nJobs,
+                    const JobBody &body,
+                    std::atomic<uint32_t> *next);
+    /**
+     * \param job Job index.
+     * \return The file holding the result of the job.
+     */
+    std::string GetResultPath(uint32_t job) const;
+
+    std::vector<int> m_cores; //!< Cores this process may run on
+    uint32_t m_workers;       //!< Number of worker processes
+    std::string m_dir;        //!< Directory holding the job results
+};
+
+inline ProcessPool::ProcessPool(uint32_t workers)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                m_cores.push_back(cpu);
+            }
+        }
+    }
+    m_workers = workers;
+    if (m_workers == 0)
+    {
+        m_workers = m_cores.empty() ? sysconf(_SC_NPROCESSORS_ONLN) : m_cores.size();
+    }
+}
+
+inline uint32_t ProcessPool::GetNWorkers() const
+{
+    return m_workers;
+}
+
+inline cpu_set_t &ProcessPool::GetWorkerShare()
+{
+    static cpu_set_t share = [] {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        return set;
+    }();
+    return share;
+}
+
+inline cpu_set_t ProcessPool::GetShare()
+{
+    cpu_set_t share = GetWorkerShare();
+    if (CPU_COUNT(&share) == 0 && sched_getaffinity(0, sizeof(share), &share) != 0)
+    {
+        CPU_ZERO(&share);
+        for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET(cpu, &share);
+        }
+    }
+    return share;
+}
+
+inline std::string ProcessPool::GetResultPath(uint32_t job) const
+{
+    return m_dir + "/job-" + std::to_string(job);
+}
+
+inline std::vector<std::string> ProcessPool::Run(uint32_t nJobs, JobBody body)
+{
+    std::vector<std::string> results(nJobs);
+    if (nJobs == 0)
+    {
+        return results;
+    }
+
+    char dir[] = "/tmp/ns3-pool-XXXXXX";
+    NS_ABORT_MSG_IF(mkdtemp(dir) == nullptr, "Cannot create the job result directory");
+    m_dir = dir;
+
+    void *shared = mmap(nullptr,
+                        sizeof(std::atomic<uint32_t>),
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS,
+                        -1,
+                        0);
+    NS_ABORT_MSG_IF(shared == MAP_FAILED, "Cannot map the shared job counter");
+    std::atomic<uint32_t> *next = new (shared) std::atomic<uint32_t>(0);
+
+    // Buffered output would otherwise be written once by every child
+    std::cout.flush();
+    std::fflush(nullptr);
+
+    std::vector<pid_t> pids;
+    for (uint32_t worker = 0; worker < std::min(m_workers, nJobs); worker++)
+    {
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "Cannot fork worker " << worker);
+        if (pid == 0)
+        {
+            WorkerLoop(worker, nJobs, body, next);
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+    for (pid_t pid : pids)
+    {
+        waitpid(pid, nullptr, 0);
+    }
+    munmap(shared, sizeof(std::atomic<uint32_t>));
+
+    for (uint32_t job = 0; job < nJobs; job++)
+    {
+        std::ifstream in(GetResultPath(job), std::ios::binary);
+        NS_ABORT_MSG_IF(!in, "Job " << job << " did not complete");
+        results[job].assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        in.close();
+        std::remove(GetResultPath(job).c_str());
+    }
+    rmdir(m_dir.c_str());
+    return results;
+}
+
+inline void ProcessPool::WorkerLoop(uint32_t worker,
+                                    uint32_t nJobs,
+                                    const JobBody &body,
+                                    std::atomic<uint32_t> *next)
+{
+    if (!m_cores.empty())
+    {
+        // The share holds every core left to this worker when there are fewer workers than
+        // cores, at least the one it is pinned to
+        cpu_set_t &share = GetWorkerShare();
+        CPU_ZERO(&share);
+        for (std::size_t i = worker % m_cores.size(); i < m_cores.size(); i += m_workers)
+        {
+            CPU_SET(m_cores[i], &share);
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(m_cores[worker % m_cores.size()], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+    for (uint32_t job = next->fetch_add(1); job < nJobs; job = next->fetch_add(1))
+    {
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "Cannot fork job " << job);
+        if (pid == 0)
+        {
+            std::string result = body(job);
+            // Publish the result atomically, a failed job leaves no file behind
+            std::string part = GetResultPath(job) + ".part";
+            std::ofstream out(part, std::ios::binary);
+            out.write(result.data(), result.size());
+            out.close();
+            bool ok = out && std::rename(part.c_str(), GetResultPath(job).c_str()) == 0;
+            std::cout.flush();
+            std::fflush(nullptr);
+            _exit(ok ? 0 : 1);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+} // namespace ns3
+
+#endif /* PROCESS_POOL_H */
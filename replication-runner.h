@@ -0,0 +1,297 @@
+#ifndef REPLICATION_RUNNER_H
+#define REPLICATION_RUNNER_H
+
+#include "ns3/abort.h"
+#include "ns3/rng-seed-manager.h"
+
+#include "running-stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+/**
+ * \brief Runs independent replications of a scenario until its metrics are precise enough.
+ *
+ * Replication r runs with the RNG run number of the process plus r, so every
+ * replication draws from its own substreams and replication 0 is the
+ * standalone run. Replications are forked in batches of one per worker. After
+ * each batch, the samples are added in replication order, so that the result
+ * does not depend on which process ended first. Replications stop once every
+ * metric has its 95% confidence interval within the target precision, or at
+ * the maximum.
+ *
+ * Fork() returns in every replication process, like fork() itself, so a
+ * scenario needs no restructuring:
+ *
+ *   if (!runner.Fork())
+ *   {
+ *       runner.Print(std::cout); // Parent, every replication is aggregated
+ *       return 0;
+ *   }
+ *   ... build and run the scenario ...
+ *   runner.Submit(names, values); // Replication, exits
+ *
+ * Fork() must be called before the simulator is first used, and before any
+ * thread is started. As with ProcessPool, the samples are handed back through
+ * a private temporary directory.
+ */
+class ReplicationRunner
+{
+  public:
+    /**
+     * \param minReplications Replications run before the precision is checked, at least 2.
+     * \param maxReplications Most replications run.
+     * \param precision Confidence interval half-width to reach, relative to the mean.
+     * \param workers Replications running at once, 0 for one per available core.
+     */
+    ReplicationRunner(uint32_t minReplications,
+                      uint32_t maxReplications,
+                      double precision,
+                      uint32_t workers = 0);
+
+    /**
+     * Run the replications, batch after batch.
+     *
+     * \return True in a replication process, which must run the scenario and
+     *         call Submit(). False in the parent, once every replication is
+     *         aggregated.
+     */
+    bool Fork();
+    /**
+     * Hand the metrics of the replication back to the parent and exit. Does
+     * nothing outside a replication process.
+     *
+     * \param names The metric names, the same in every replication.
+     * \param values The value of each metric.
+     */
+    void Submit(const std::vector<std::string> &names, const std::vector<double> &values);
+
+    /// \return Whether this process is a replication
+    bool IsReplication() const;
+    /// \return The index of the replication of this process
+    uint32_t GetReplication() const;
+    /// \return The number of replications aggregated
+    uint32_t GetNReplications() const;
+    /// \return Whether every metric has a sample per replication and reached the precision
+    bool IsPrecise() const;
+
+    /// \return The metric names, in the order of the first replication
+    const std::vector<std::string> &GetNames() const;
+    /**
+     * \param name A metric name.
+     * \return The statistics of the metric over the replications.
+     */
+    const RunningStats &GetStats(const std::string &name) const;
+    /**
+     * Print the mean, confidence interval and number of samples of every
+     * metric, one per line.
+     *
+     * \param os The output stream.
+     */
+    void Print(std::ostream &os) const;
+
+  private:
+    /**
+     * \param replication A replication index.
+     * \return The file holding the samples of the replication.
+     */
+    std::string GetResultPath(uint32_t replication) const;
+    /**
+     * Add the samples of a replication to the statistics.
+     *
+     * \param replication The replication index.
+     */
+    void Collect(uint32_t replication);
+
+    uint32_t m_minReplications;                  //!< Replications before the precision is checked
+    uint32_t m_maxReplications;                  //!< Most replications
+    double m_precision;                          //!< Relative half-width to reach
+    uint32_t m_workers;                          //!< Replications running at once
+    uint32_t m_firstRun;                         //!< RNG run number of replication 0
+    int64_t m_replication;                       //!< Replication of this process, -1 in the parent
+    uint32_t m_done;                             //!< Replications aggregated
+    std::string m_dir;                           //!< Directory holding the samples
+    std::vector<std::string> m_names;            //!< Metric names
+    std::map<std::string, RunningStats> m_stats; //!< Statistics of each metric
+};
+
+inline ReplicationRunner::ReplicationRunner(uint32_t minReplications,
+                                            uint32_t maxReplications,
+                                            double precision,
+                                            uint32_t workers)
+    : m_minReplications(std::max<uint32_t>(2, minReplications)),
+      m_maxReplications(maxReplications),
+      m_precision(precision),
+      m_workers(workers == 0 ? sysconf(_SC_NPROCESSORS_ONLN) : workers),
+      m_firstRun(RngSeedManager::GetRun()),
+      m_replication(-1),
+      m_done(0)
+{
+    m_minReplications = std::min(m_minReplications, m_maxReplications);
+}
+
+inline bool ReplicationRunner::IsReplication() const
+{
+    return m_replication >= 0;
+}
+
+inline uint32_t ReplicationRunner::GetReplication() const
+{
+    return m_replication;
+}
+
+inline uint32_t ReplicationRunner::GetNReplications() const
+{
+    return m_done;
+}
+
+inline const std::vector<std::string> &ReplicationRunner::GetNames() const
+{
+    return m_names;
+}
+
+inline const RunningStats &ReplicationRunner::GetStats(const std::string &name) const
+{
+    auto stats = m_stats.find(name);
+    NS_ABORT_MSG_IF(stats == m_stats.end(), "No metric " << name);
+    return stats->second;
+}
+
+inline std::string ReplicationRunner::GetResultPath(uint32_t replication) const
+{
+    return m_dir + "/replication-" + std::to_string(replication);
+}
+
+inline bool ReplicationRunner::IsPrecise() const
+{
+    for (const auto &metric : m_stats)
+    {
+        // A metric missing from some replications, e.g. the delay of a flow that received
+        // nothing, has no interval over all of them. A metric that is always 0 is exact, any
+        // other one needs a relative half-width
+        const RunningStats &stats = metric.second;
+        if (stats.GetN() < 2 || stats.GetN() < m_done ||
+            stats.GetHalfWidth() > m_precision * std::abs(stats.GetMean()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool ReplicationRunner::Fork()
+{
+    NS_ABORT_MSG_IF(IsReplication(), "Fork() called in a replication");
+    char dir[] = "/tmp/ns3-replications-XXXXXX";
+    NS_ABORT_MSG_IF(mkdtemp(dir) == nullptr, "Cannot create the replication directory");
+    m_dir = dir;
+
+    while (m_done < m_maxReplications && (m_done < m_minReplications || !IsPrecise()))
+    {
+        // Buffered output would otherwise be written once by every child
+        std::cout.flush();
+        std::fflush(nullptr);
+
+        uint32_t batch = std::min(m_workers, m_maxReplications - m_done);
+        std::vector<pid_t> pids;
+        for (uint32_t i = 0; i < batch; i++)
+        {
+            pid_t pid = fork();
+            NS_ABORT_MSG_IF(pid < 0, "Cannot fork replication " << m_done + i);
+            if (pid == 0)
+            {
+                m_replication = m_done + i;
+                RngSeedManager::SetRun(m_firstRun + m_replication);
+                return true;
+            }
+            pids.push_back(pid);
+        }
+        for (pid_t pid : pids)
+        {
+            waitpid(pid, nullptr, 0);
+        }
+        for (uint32_t i = 0; i < batch; i++)
+        {
+            Collect(m_done + i);
+        }
+        m_done += batch;
+    }
+    rmdir(m_dir.c_str());
+    return false;
+}
+
+inline void ReplicationRunner::Submit(const std::vector<std::string> &names,
+                                      const std::vector<double> &values)
+{
+    if (!IsReplication())
+    {
+        return;
+    }
+    NS_ABORT_MSG_IF(names.size() != values.size(), "One value per metric name is needed");
+    // Publish the samples atomically, a failed replication leaves no file behind
+    std::string part = GetResultPath(m_replication) + ".part";
+    std::ofstream out(part);
+    out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        out << values[i] << " " << names[i] << "\n";
+    }
+    out.close();
+    bool ok = out && std::rename(part.c_str(), GetResultPath(m_replication).c_str()) == 0;
+    std::cout.flush();
+    std::fflush(nullptr);
+    _exit(ok ? 0 : 1);
+}
+
+inline void ReplicationRunner::Collect(uint32_t replication)
+{
+    std::ifstream in(GetResultPath(replication));
+    NS_ABORT_MSG_IF(!in, "Replication " << replication << " did not complete");
+    double value;
+    std::string name;
+    while (in >> value && std::getline(in >> std::ws, name))
+    {
+        auto stats = m_stats.find(name);
+        if (stats == m_stats.end())
+        {
+            m_names.push_back(name);
+            stats = m_stats.emplace(name, RunningStats()).first;
+        }
+        stats->second.Add(value);
+    }
+    in.close();
+    std::remove(GetResultPath(replication).c_str());
+}
+
+inline void ReplicationRunner::Print(std::ostream &os) const
+{
+    std::ostringstream lines;
+    lines << m_done << " replications, runs " << m_firstRun << " to " << m_firstRun + m_done - 1
+          << ", " << (IsPrecise() ? "precision reached" : "precision not reached") << "\n";
+    for (const auto &name : m_names)
+    {
+        const RunningStats &stats = m_stats.at(name);
+        lines << name << ": " << stats.GetMean() << " +/- " << stats.GetHalfWidth() << " ("
+              << stats.GetN() << " samples)\n";
+    }
+    os << lines.str() << std::flush;
+}
+
+} // namespace ns3
+
+#endif /* REPLICATION_RUNNER_H */
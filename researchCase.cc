@@ -8,16 +8,38 @@
 #include "ns3/mobility-helper.h"
 #include "ns3/mobility-model.h"
 #include "ns3/on-off-helper.h"
+#include "ns3/onoff-application.h"
 #include "ns3/packet-sink-helper.h"
+#include "ns3/rectangle.h"
 #include "ns3/ssid.h"
+#include "ns3/string.h"
 #include "ns3/uinteger.h"
-#include "ns3/wifi-mac-header.h"
 #include "ns3/wifi-mac.h"
 #include "ns3/wifi-net-device.h"
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/yans-wifi-phy.h"
 
+#include "async-log.h"
+#include "event-profiler.h"
+#include "ladder-scheduler.h"
+#include "metrics-sink.h"
+#include "packet-capture.h"
+#include "packet-pool.h"
+#include "process-pool.h"
+#include "replication-runner.h"
+#include "running-stats.h"
+#include "sim-perf.h"
+#include "trace-binding.h"
+#include "warm-fork.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("PowerAdaptationDistance");
@@ -25,32 +47,143 @@ NS_LOG_COMPONENT_DEFINE("PowerAdaptationDistance");
 /// Packet size generated at the AP
 static const uint32_t packetSize = 1500;
 
+/// Parameters of a single power/rate adaptation case
+struct CaseConfig
+{
+    std::string manager;       ///< Remote station manager of the AP
+    double maxPower;           ///< Maximum transmission level [dBm]
+    double minPower;           ///< Minimum transmission level [dBm]
+    uint32_t powerLevels;      ///< Number of transmission power levels
+    uint32_t rtsThreshold;     ///< RTS threshold [bytes]
+    double trafficRate;        ///< CBR traffic of each AP, shared by its STAs [Mbps]
+    int ap1_x;                 ///< AP position on the x axis
+    int ap1_y;                 ///< AP position on the y axis
+    int sta1_x;                ///< Initial STA position on the x axis
+    int sta1_y;                ///< Initial STA position on the y axis
+    uint32_t nAps;             ///< Number of APs
+    uint32_t nStas;            ///< Number of STAs per AP
+    double apSpacing;          ///< Distance between two APs on the x axis [m]
+    std::string staPlacement;  ///< STA placement around their AP: offset or disc
+    double staRadius;          ///< Radius of the disc placement [m]
+    std::string staMobility;   ///< STA mobility: step, static or walk
+    double walkSpeed;          ///< Speed of the walking STAs [m/s]
+    uint32_t steps;            ///< Number of distances to try
+    uint32_t stepsSize;        ///< Distance between steps [m]
+    uint32_t stepsTime;        ///< Time on each step [s]
+    bool adaptiveDwell;        ///< Whether each step lasts until its throughput is precise enough
+    double dwellWindow;        ///< Throughput sampling window of the adaptive dwell [s]
+    double dwellMin;           ///< Shortest adaptive dwell [s]
+    double dwellMax;           ///< Longest adaptive dwell [s]
+    double dwellPrecision;     ///< Confidence interval half-width ending a step, relative to the mean
+    double warmupTime;         ///< Time before the first step is measured [s]
+    std::string metricsFile;   ///< Metrics file the samples are streamed to
+    std::string stationsFile;  ///< Metrics file of every STA, empty for none
+    std::string capture;       ///< Capture level: off, header, sampled or ring
+    std::string captureFile;   ///< Capture filename, without the .pcap extension
+    uint32_t captureSnaplen;   ///< Bytes kept per captured frame
+    uint32_t captureSampleN;   ///< Frames per captured frame in sampled mode
+    uint32_t captureRingSize;  ///< Frames kept in memory in ring mode
+    double captureTriggerMbps; ///< Throughput below which the ring is dumped [Mbps]
+    double captureDumpGap;     ///< Least time between two ring dumps on a rate change [s]
+    bool headless;             ///< Whether logging is disabled
+    std::string logFile;       ///< Binary log file, empty to log text to std::clog
+    std::string profile;       ///< Event profile report file, empty for none
+    std::string scheduler;     ///< Event scheduler: map, heap, list, calendar or ladder
+    bool packetPool;           ///< Whether allocations are served from slab pools
+    bool poolStats;            ///< Whether the allocation counters are printed
+    std::string perfReport;    ///< File the performance report is appended to, empty for none
+};
+
 class NodeStatistics
 {
   public:
     NodeStatistics(NetDeviceContainer aps, NetDeviceContainer stas);
-    void PhyCallback(std::string path, Ptr<const Packet> packet, double powerW);
-    void RxCallback(std::string path, Ptr<const Packet> packet, const Address &from);
+    void PhyCallback(Ptr<const Packet> packet, double powerW);
+    void RxCallback(uint32_t sta, Ptr<const Packet> packet);
+    static void StationRxCallback(NodeStatistics *statistics,
+                                  uint32_t sta,
+                                  Ptr<const Packet> packet,
+                                  const Address &from);
     void PowerCallback(std::string path, double oldPower, double newPower, Mac48Address dest);
     void RateCallback(std::string path, DataRate oldRate, DataRate newRate, Mac48Address dest);
+    void AssociationCallback(std::string path, uint16_t aid, Mac48Address address);
     void SetPosition(Ptr<Node> node, Vector position);
-    void AdvancePosition(Ptr<Node> node, int stepsSize, int stepsTime);
+    void AdvancePosition(int stepsSize, int stepsTime);
+    void SetAdaptiveDwell(double window,
+                          double minDwell,
+                          double maxDwell,
+                          double precision,
+                          uint32_t steps);
+    void SampleWindow(int stepsSize);
+    void ResetCounters();
     Vector GetPosition(Ptr<Node> node);
-    Gnuplot2dDataset GetDatafile();
-    Gnuplot2dDataset GetPowerDatafile();
+    void OpenMetrics(std::string fileName);
+    void OpenStationMetrics(std::string fileName);
+    void CloseMetrics();
+    void SetThroughputCallback(Callback<void, double> callback);
 
   private:
-    typedef std::vector<std::pair<Time, DataRate>> TxTime;
+    /// Entry of the direct-mapped address to station index cache
+    struct StationCacheEntry
+    {
+        uint64_t key;   ///< Address key, stationCacheEmpty if unused
+        uint32_t index; ///< Station index
+    };
+
+    /// Number of entries of the station cache, a power of two
+    static const uint32_t stationCacheSize = 64;
+    /// Key of an unused station cache entry, never produced by a 48-bit address
+    static const uint64_t stationCacheEmpty = ~0ULL;
+    /// Packet sizes covered by the airtime table, enough for any non-aggregated 802.11g MPDU
+    static const uint32_t airtimeTableSize = 2400;
+
     void SetupPhy(Ptr<WifiPhy> phy);
-    Time GetCalcTxTime(DataRate rate);
-    std::map<Mac48Address, double> m_currentPower;
-    std::map<Mac48Address, DataRate> m_currentRate;
-    uint32_t m_bytesTotal;
+    double GetCalcTxTime(uint32_t mode, uint32_t size);
+    uint32_t GetModeIndex(DataRate rate);
+    uint32_t GetPowerLevel(double power);
+    uint32_t GetStationIndex(Mac48Address address);
+    uint32_t GetStationIndex(uint64_t key);
+    uint32_t AddStation(uint64_t key);
+    static uint64_t GetAddressKey(const uint8_t address[6]);
+    void RecordStep(int stepsSize, double dwell);
+
+    // Per-station state, indexed by the dense station index
+    std::vector<uint32_t> m_stationPowerLevel;
+    std::vector<uint32_t> m_stationMode;
+    std::vector<uint32_t> m_stationAirtimeRow;
+    std::vector<uint64_t> m_stationBytes;  //!< Bytes received in the step
+    std::vector<double> m_stationEnergy;   //!< Energy sent in the step [mJ]
+    std::unordered_map<uint64_t, uint32_t> m_stationIndex;
+    StationCacheEntry m_stationCache[stationCacheSize];
+
+    // Tables built by SetupPhy
+    Ptr<WifiPhy> m_phy;
+    std::vector<WifiTxVector> m_modeTxVector;
+    std::vector<DataRate> m_modeRate;
+    std::vector<double> m_airtime; //!< Airtime [s], airtimeTableSize entries per mode
+    std::vector<double> m_powerMw; //!< Transmit power [mW] of each power level
+    double m_powerStart;
+    double m_powerStep;
+    uint32_t m_defaultPowerLevel;
+    uint32_t m_defaultMode;
+
+    NodeContainer m_stas; //!< STAs, STA n has the station index n + 1
+    uint32_t m_nAps;      //!< Number of APs
+    uint64_t m_bytesTotal;
     double m_totalEnergy;
     double m_totalTime;
-    TxTime m_timeTable;
-    Gnuplot2dDataset m_output;
-    Gnuplot2dDataset m_output_power;
+    MetricsSink m_metrics;
+    MetricsSink m_stationMetrics; //!< Rows of every STA at every step, if open
+    Callback<void, double> m_throughputCallback; //!< Called with the throughput of every step
+
+    // Adaptive dwell
+    double m_window;             //!< Throughput sampling window [s], 0 for a fixed dwell
+    double m_minDwell;           //!< Shortest dwell [s]
+    double m_maxDwell;           //!< Longest dwell [s]
+    double m_precision;          //!< Relative half-width of the confidence interval ending a step
+    uint32_t m_stepsLeft;        //!< Steps to record before the simulation stops
+    uint64_t m_windowStartBytes; //!< m_bytesTotal at the start of the window
+    RunningStats m_windows;      //!< Throughput of the windows of the step [Mbps]
 };
 
 NodeStatistics::NodeStatistics(NetDeviceContainer aps, NetDeviceContainer stas)
@@ -59,26 +192,41 @@ NodeStatistics::NodeStatistics(NetDeviceContainer aps, NetDeviceContainer stas)
     Ptr<WifiNetDevice> wifiDevice = DynamicCast<WifiNetDevice>(device);
     Ptr<WifiPhy> phy = wifiDevice->GetPhy();
     SetupPhy(phy);
-    DataRate dataRate = DataRate(phy->GetDefaultMode().GetDataRate(phy->GetChannelWidth()));
-    double power = phy->GetTxPowerEnd();
-    for (uint32_t j = 0; j < stas.GetN(); j++)
+    m_defaultMode =
+        GetModeIndex(DataRate(phy->GetDefaultMode().GetDataRate(phy->GetChannelWidth())));
+    m_defaultPowerLevel = GetPowerLevel(phy->GetTxPowerEnd());
+    for (auto &entry : m_stationCache)
+    {
+        entry.key = stationCacheEmpty;
+    }
+    // The broadcast address comes first, then the STAs in order
+    m_stationPowerLevel.reserve(stas.GetN() + 1);
+    m_stationMode.reserve(stas.GetN() + 1);
+    m_stationAirtimeRow.reserve(stas.GetN() + 1);
+    GetStationIndex(Mac48Address::GetBroadcast());
+    for (uint32_t sta = 0; sta < stas.GetN(); sta++)
     {
-        Ptr<NetDevice> staDevice = stas.Get(j);
-        Ptr<WifiNetDevice> wifiStaDevice = DynamicCast<WifiNetDevice>(staDevice);
-        Mac48Address addr = wifiStaDevice->GetMac()->GetAddress();
-        m_currentPower[addr] = power;
-        m_currentRate[addr] = dataRate;
+        GetStationIndex(Mac48Address::ConvertFrom(stas.Get(sta)->GetAddress()));
+        m_stas.Add(stas.Get(sta)->GetNode());
     }
-    m_currentRate[Mac48Address("ff:ff:ff:ff:ff:ff")] = dataRate;
+    m_nAps = aps.GetN();
     m_totalEnergy = 0;
     m_totalTime = 0;
     m_bytesTotal = 0;
-    m_output.SetTitle("Throughput Mbits/s");
-    m_output_power.SetTitle("Average Transmit Power");
+    m_window = 0;
+    m_minDwell = 0;
+    m_maxDwell = 0;
+    m_precision = 0;
+    m_stepsLeft = 0;
+    m_windowStartBytes = 0;
 }
 
 void NodeStatistics::SetupPhy(Ptr<WifiPhy> phy)
 {
+    m_phy = phy;
+    m_modeTxVector.clear();
+    m_modeRate.clear();
+    m_airtime.clear();
     for (const auto &mode : phy->GetModeList())
     {
         WifiTxVector txVector;
@@ -86,42 +234,141 @@ void NodeStatistics::SetupPhy(Ptr<WifiPhy> phy)
         txVector.SetPreambleType(WIFI_PREAMBLE_LONG);
         txVector.SetChannelWidth(phy->GetChannelWidth());
         DataRate dataRate(mode.GetDataRate(phy->GetChannelWidth()));
-        Time time = phy->CalculateTxDuration(packetSize, txVector, phy->GetPhyBand());
-        NS_LOG_DEBUG(mode.GetUniqueName() << " " << time.GetSeconds() << " " << dataRate);
-        m_timeTable.emplace_back(time, dataRate);
+        for (uint32_t size = 0; size < airtimeTableSize; size++)
+        {
+            Time time = phy->CalculateTxDuration(size, txVector, phy->GetPhyBand());
+            m_airtime.push_back(time.GetSeconds());
+        }
+        NS_LOG_DEBUG(mode.GetUniqueName() << " " << m_airtime[m_airtime.size() - 1] << " "
+                                          << dataRate);
+        m_modeTxVector.push_back(txVector);
+        m_modeRate.push_back(dataRate);
+    }
+
+    // Same levels as WifiPhy::GetPowerDbm
+    uint32_t levels = phy->GetNTxPower();
+    m_powerStart = phy->GetTxPowerStart();
+    m_powerStep = levels > 1 ? (phy->GetTxPowerEnd() - m_powerStart) / (levels - 1) : 0;
+    m_powerMw.clear();
+    for (uint32_t level = 0; level < std::max(levels, 1U); level++)
+    {
+        m_powerMw.push_back(pow(10.0, (m_powerStart + level * m_powerStep) / 10.0));
     }
 }
 
-Time NodeStatistics::GetCalcTxTime(DataRate rate)
+uint32_t NodeStatistics::GetModeIndex(DataRate rate)
 {
-    for (auto i = m_timeTable.begin(); i != m_timeTable.end(); i++)
+    for (uint32_t mode = 0; mode < m_modeRate.size(); mode++)
     {
-        if (rate == i->second)
+        if (rate == m_modeRate[mode])
         {
-            return i->first;
+            return mode;
         }
     }
     NS_ASSERT(false);
-    return Seconds(0);
+    return 0;
+}
+
+uint32_t NodeStatistics::GetPowerLevel(double power)
+{
+    if (m_powerStep == 0)
+    {
+        return 0;
+    }
+    double level = std::round((power - m_powerStart) / m_powerStep);
+    return std::min<double>(std::max(level, 0.0), m_powerMw.size() - 1);
 }
 
-void NodeStatistics::PhyCallback(std::string path, Ptr<const Packet> packet, double powerW)
+double NodeStatistics::GetCalcTxTime(uint32_t mode, uint32_t size)
 {
-    WifiMacHeader head;
-    packet->PeekHeader(head);
-    Mac48Address dest = head.GetAddr1();
+    if (size < airtimeTableSize)
+    {
+        return m_airtime[mode * airtimeTableSize + size];
+    }
+    return m_phy->CalculateTxDuration(size, m_modeTxVector[mode], m_phy->GetPhyBand())
+        .GetSeconds();
+}
+
+uint64_t NodeStatistics::GetAddressKey(const uint8_t address[6])
+{
+    uint64_t key = 0;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        key = (key << 8) | address[i];
+    }
+    return key;
+}
+
+uint32_t NodeStatistics::AddStation(uint64_t key)
+{
+    uint32_t index = m_stationMode.size();
+    m_stationPowerLevel.push_back(m_defaultPowerLevel);
+    m_stationMode.push_back(m_defaultMode);
+    m_stationAirtimeRow.push_back(m_defaultMode * airtimeTableSize);
+    m_stationBytes.push_back(0);
+    m_stationEnergy.push_back(0);
+    m_stationIndex[key] = index;
+    return index;
+}
+
+uint32_t NodeStatistics::GetStationIndex(Mac48Address address)
+{
+    uint8_t buffer[6];
+    address.CopyTo(buffer);
+    return GetStationIndex(GetAddressKey(buffer));
+}
+
+uint32_t NodeStatistics::GetStationIndex(uint64_t key)
+{
+    StationCacheEntry &entry = m_stationCache[(key ^ (key >> 8)) & (stationCacheSize - 1)];
+    if (entry.key != key)
+    {
+        // Frames to a station may show up before its association completes
+        auto it = m_stationIndex.find(key);
+        entry.index = it != m_stationIndex.end() ? it->second : AddStation(key);
+        entry.key = key;
+    }
+    return entry.index;
+}
+
+void NodeStatistics::AssociationCallback(std::string path, uint16_t aid, Mac48Address address)
+{
+    uint32_t station = GetStationIndex(address);
+    NS_LOG_DEBUG("Station " << address << " associated with AID " << aid << ", index "
+                            << station);
+}
+
+void NodeStatistics::PhyCallback(Ptr<const Packet> packet, double powerW)
+{
+    // Frame Control and Addr1 are at fixed offsets of the MPDU, copy them instead of
+    // deserializing the whole WifiMacHeader. 802.11g frames are never aggregated, so the
+    // MPDU starts the packet.
+    uint8_t head[10];
+    if (packet->CopyData(head, sizeof(head)) < sizeof(head))
+    {
+        return;
+    }
+    uint8_t type = (head[0] >> 2) & 0x03;
+    uint8_t subtype = head[0] >> 4;
 
-    if (head.GetType() == WIFI_MAC_DATA)
+    // Type 2, subtype 0 is WIFI_MAC_DATA
+    if (type == 2 && subtype == 0)
     {
-        m_totalEnergy += pow(10.0, m_currentPower[dest] / 10.0) *
-                         GetCalcTxTime(m_currentRate[dest]).GetSeconds();
-        m_totalTime += GetCalcTxTime(m_currentRate[dest]).GetSeconds();
+        uint32_t station = GetStationIndex(GetAddressKey(head + 4));
+        uint32_t size = packet->GetSize();
+        double txTime = size < airtimeTableSize
+                            ? m_airtime[m_stationAirtimeRow[station] + size]
+                            : GetCalcTxTime(m_stationMode[station], size);
+        double powerMw = m_powerMw[m_stationPowerLevel[station]];
+        m_stationEnergy[station] = std::fma(powerMw, txTime, m_stationEnergy[station]);
+        m_totalEnergy = std::fma(powerMw, txTime, m_totalEnergy);
+        m_totalTime += txTime;
     }
 }
 
 void NodeStatistics::PowerCallback(std::string path, double oldPower, double newPower, Mac48Address dest)
 {
-    m_currentPower[dest] = newPower;
+    m_stationPowerLevel[GetStationIndex(dest)] = GetPowerLevel(newPower);
 }
 
 void NodeStatistics::RateCallback(std::string path,
@@ -129,12 +376,32 @@ void NodeStatistics::RateCallback(std::string path,
                                   DataRate newRate,
                                   Mac48Address dest)
 {
-    m_currentRate[dest] = newRate;
+    uint32_t station = GetStationIndex(dest);
+    m_stationMode[station] = GetModeIndex(newRate);
+    m_stationAirtimeRow[station] = m_stationMode[station] * airtimeTableSize;
 }
 
-void NodeStatistics::RxCallback(std::string path, Ptr<const Packet> packet, const Address &from)
+void NodeStatistics::RxCallback(uint32_t sta, Ptr<const Packet> packet)
 {
     m_bytesTotal += packet->GetSize();
+    m_stationBytes[sta + 1] += packet->GetSize();
+}
+
+/**
+ * PacketSink Rx trace sink, bound to the statistics and the index of the STA
+ * instead of being told apart by a per-STA Config path.
+ *
+ * \param statistics The statistics.
+ * \param sta The index of the receiving STA.
+ * \param packet The packet received.
+ * \param from The sender address.
+ */
+void NodeStatistics::StationRxCallback(NodeStatistics *statistics,
+                                       uint32_t sta,
+                                       Ptr<const Packet> packet,
+                                       const Address &from)
+{
+    statistics->RxCallback(sta, packet);
 }
 
 void NodeStatistics::SetPosition(Ptr<Node> node, Vector position)
@@ -149,36 +416,158 @@ Vector NodeStatistics::GetPosition(Ptr<Node> node)
     return mobility->GetPosition();
 }
 
-void NodeStatistics::AdvancePosition(Ptr<Node> node, int stepsSize, int stepsTime)
+void NodeStatistics::RecordStep(int stepsSize, double dwell)
 {
-    Vector pos = GetPosition(node);
-    double mbs = ((m_bytesTotal * 8.0) / (1000000 * stepsTime));
+    // Distance of the first STA, throughput per STA and average transmit power per AP
+    Vector pos = GetPosition(m_stas.Get(0));
+    double mbs = ((m_bytesTotal * 8.0) / (1000000 * dwell)) / m_stas.GetN();
     m_bytesTotal = 0;
-    double atp = m_totalEnergy / stepsTime;
+    double atp = m_totalEnergy / dwell / m_nAps;
     m_totalEnergy = 0;
     m_totalTime = 0;
-    m_output_power.Add(pos.x, atp);
-    m_output.Add(pos.x, mbs);
+    // Flush every step so that a crashed run keeps the distances done so far
+    if (m_window > 0)
+    {
+        m_metrics.Append(
+            {Simulator::Now().GetSeconds(), pos.x, mbs, atp, dwell, m_windows.GetHalfWidth()});
+    }
+    else
+    {
+        m_metrics.Append({Simulator::Now().GetSeconds(), pos.x, mbs, atp});
+    }
+    m_metrics.Flush();
+    if (m_stationMetrics.IsOpen())
+    {
+        for (uint32_t sta = 0; sta < m_stas.GetN(); sta++)
+        {
+            Vector staPos = GetPosition(m_stas.Get(sta));
+            m_stationMetrics.Append({Simulator::Now().GetSeconds(),
+                                     static_cast<double>(sta),
+                                     staPos.x,
+                                     staPos.y,
+                                     m_stationBytes[sta + 1] * 8.0 / (1000000 * dwell),
+                                     m_stationEnergy[sta + 1] / dwell});
+        }
+        m_stationMetrics.Flush();
+    }
+    std::fill(m_stationBytes.begin(), m_stationBytes.end(), 0);
+    std::fill(m_stationEnergy.begin(), m_stationEnergy.end(), 0);
+    if (!m_throughputCallback.IsNull())
+    {
+        m_throughputCallback(mbs);
+    }
+    if (stepsSize == 0)
+    {
+        return;
+    }
+    for (uint32_t sta = 0; sta < m_stas.GetN(); sta++)
+    {
+        Vector staPos = GetPosition(m_stas.Get(sta));
+        staPos.x += stepsSize;
+        SetPosition(m_stas.Get(sta), staPos);
+    }
     pos.x += stepsSize;
-    SetPosition(node, pos);
     NS_LOG_INFO("At time " << Simulator::Now().GetSeconds() << " sec; setting new position to "
                            << pos);
+}
+
+void NodeStatistics::AdvancePosition(int stepsSize, int stepsTime)
+{
+    RecordStep(stepsSize, stepsTime);
     Simulator::Schedule(Seconds(stepsTime),
                         &NodeStatistics::AdvancePosition,
                         this,
-                        node,
                         stepsSize,
                         stepsTime);
 }
 
-Gnuplot2dDataset NodeStatistics::GetDatafile()
+/**
+ * Sample the throughput by windows instead of a fixed time per step. Call
+ * before OpenMetrics(), which then adds the dwell and confidence interval
+ * half-width columns, and schedule SampleWindow() instead of AdvancePosition().
+ *
+ * \param window Throughput sampling window [s].
+ * \param minDwell Shortest time on a step [s].
+ * \param maxDwell Longest time on a step [s].
+ * \param precision Half-width of the 95% confidence interval of the throughput, relative to
+ *                  its mean, below which the STA moves to the next step.
+ * \param steps Steps after which the simulation stops.
+ */
+void NodeStatistics::SetAdaptiveDwell(double window,
+                                      double minDwell,
+                                      double maxDwell,
+                                      double precision,
+                                      uint32_t steps)
+{
+    m_window = window;
+    m_minDwell = minDwell;
+    m_maxDwell = maxDwell;
+    m_precision = precision;
+    m_stepsLeft = steps;
+}
+
+void NodeStatistics::SampleWindow(int stepsSize)
+{
+    m_windows.Add((m_bytesTotal - m_windowStartBytes) * 8.0 / (1000000 * m_window));
+    m_windowStartBytes = m_bytesTotal;
+    // Counted rather than timed, the dwell is a whole number of windows
+    double dwell = m_windows.GetN() * m_window;
+    bool precise = m_windows.GetN() > 1 &&
+                   m_windows.GetHalfWidth() <= m_precision * m_windows.GetMean();
+    if (dwell < m_maxDwell - m_window / 2 && (dwell < m_minDwell - m_window / 2 || !precise))
+    {
+        Simulator::Schedule(Seconds(m_window), &NodeStatistics::SampleWindow, this, stepsSize);
+        return;
+    }
+    RecordStep(stepsSize, dwell);
+    m_windows.Reset();
+    m_windowStartBytes = 0;
+    if (--m_stepsLeft == 0)
+    {
+        Simulator::Stop();
+        return;
+    }
+    Simulator::Schedule(Seconds(m_window), &NodeStatistics::SampleWindow, this, stepsSize);
+}
+
+void NodeStatistics::ResetCounters()
+{
+    m_bytesTotal = 0;
+    m_totalEnergy = 0;
+    m_totalTime = 0;
+    m_windowStartBytes = 0;
+    m_windows.Reset();
+    std::fill(m_stationBytes.begin(), m_stationBytes.end(), 0);
+    std::fill(m_stationEnergy.begin(), m_stationEnergy.end(), 0);
+}
+
+void NodeStatistics::OpenMetrics(std::string fileName)
+{
+    if (m_window > 0)
+    {
+        m_metrics.Open(fileName,
+                       {"time", "distance", "throughput", "power", "dwell", "halfWidth"});
+    }
+    else
+    {
+        m_metrics.Open(fileName, {"time", "distance", "throughput", "power"});
+    }
+}
+
+void NodeStatistics::OpenStationMetrics(std::string fileName)
+{
+    m_stationMetrics.Open(fileName, {"time", "station", "x", "y", "throughput", "power"});
+}
+
+void NodeStatistics::CloseMetrics()
 {
-    return m_output;
+    m_metrics.Close();
+    m_stationMetrics.Close();
 }
 
-Gnuplot2dDataset NodeStatistics::GetPowerDatafile()
+void NodeStatistics::SetThroughputCallback(Callback<void, double> callback)
 {
-    return m_output_power;
+    m_throughputCallback = callback;
 }
 
 /**
@@ -209,60 +598,51 @@ void RateCallback(std::string path, DataRate oldRate, DataRate newRate, Mac48Add
                 << " " << dest << " Old rate=" << oldRate << " New rate=" << newRate);
 }
 
-int main(int argc, char *argv[])
+/**
+ * Build and run one case, moving the STA away from the AP step by step.
+ *
+ * The throughput and average transmit power at each distance are streamed to
+ * the metrics file of the case.
+ *
+ * With forks, the case is warmed up once, then each fork continues it in its
+ * own child process with its RTS threshold and traffic rate, and streams its
+ * samples to its own metrics and log files. The other parameters of the forks
+ * are those of the case, the objects they configure are built before the fork.
+ *
+ * \param config The case parameters.
+ * \param forks The variants forked at the end of the warm-up, none to run the case itself.
+ * \param forkWorkers Most forks running at once, 0 for one per available core.
+ */
+void RunCase(const CaseConfig &config,
+             const std::vector<CaseConfig> &forks = {},
+             uint32_t forkWorkers = 0)
 {
-    LogComponentEnable("AarfWifiManager", LOG_LEVEL_INFO);
-    LogComponentEnable("MinstrelWifiManager", LOG_LEVEL_INFO);
-
-    double maxPower = 20;
-    double minPower = 20;
-    uint32_t powerLevels = 1;
-
-    uint32_t rtsThreshold = 2346;
-    std::string manager = "ns3::ParfWifiManager";
-    std::string outputFileName = "parf";
-    int ap1_x = 0;
-    int ap1_y = 0;
-    int sta1_x = 5;
-    int sta1_y = 0;
-    uint32_t steps = 260;
-    uint32_t stepsSize = 1;
-    uint32_t stepsTime = 1;
-
-    CommandLine cmd(__FILE__);
-    cmd.AddValue("manager", "PRC Manager", manager);
-    cmd.AddValue("rtsThreshold", "RTS threshold", rtsThreshold);
-    cmd.AddValue("outputFileName", "Output filename", outputFileName);
-    cmd.AddValue("steps", "How many different distances to try", steps);
-    cmd.AddValue("stepsTime", "Time on each step", stepsTime);
-    cmd.AddValue("stepsSize", "Distance between steps", stepsSize);
-    cmd.AddValue("maxPower", "Maximum available transmission level (dbm).", maxPower);
-    cmd.AddValue("minPower", "Minimum available transmission level (dbm).", minPower);
-    cmd.AddValue("powerLevels",
-                 "Number of transmission power levels available between "
-                 "TxPowerStart and TxPowerEnd included.",
-                 powerLevels);
-    cmd.AddValue("AP1_x", "Position of AP1 in x coordinate", ap1_x);
-    cmd.AddValue("AP1_y", "Position of AP1 in y coordinate", ap1_y);
-    cmd.AddValue("STA1_x", "Position of STA1 in x coordinate", sta1_x);
-    cmd.AddValue("STA1_y", "Position of STA1 in y coordinate", sta1_y);
-    cmd.Parse(argc, argv);
-
-    if (steps == 0)
+    // Selected before the simulator is first used in this process
+    PacketPool::Enable(config.packetPool);
+    PacketPool::ResetStats();
+    SetSchedulerType(config.scheduler);
+    if (!config.profile.empty())
     {
-        std::cout << "Exiting without running simulation; steps value of 0" << std::endl;
-        return 0;
+        ProfilingSimulatorImpl::Enable(config.profile);
     }
-
-    uint32_t simuTime = (steps + 1) * stepsTime;
+    PerfReport perf;
+    // Started here rather than in main, the writer thread would not survive the fork of a job
+    AsyncLog asyncLog;
+    if (!config.headless && !config.logFile.empty())
+    {
+        asyncLog.Start(config.logFile);
+    }
+    // With an adaptive dwell the simulation stops after the last step, usually well before
+    double stepMaxTime = config.adaptiveDwell ? config.dwellMax : config.stepsTime;
+    double simuTime = config.warmupTime + (config.steps + 1) * stepMaxTime;
 
     // Define the APs
     NodeContainer wifiApNodes;
-    wifiApNodes.Create(1);
+    wifiApNodes.Create(config.nAps);
 
-    // Define the STAs
+    // Define the STAs, nStas per AP, the STAs of AP a are a * nStas to (a + 1) * nStas - 1
     NodeContainer wifiStaNodes;
-    wifiStaNodes.Create(1);
+    wifiStaNodes.Create(config.nAps * config.nStas);
 
     Config::SetDefault("ns3::WifiPhy::RxSensitivity", DoubleValue(-120.0));
     Config::SetDefault("ns3::WifiPhy::TxPowerLevels", UintegerValue(1));
@@ -284,79 +664,186 @@ int main(int argc, char *argv[])
     // Configure the STA node
     wifi.SetRemoteStationManager("ns3::MinstrelWifiManager",
                                  "RtsCtsThreshold",
-                                 UintegerValue(rtsThreshold));
-    wifiPhy.Set("TxPowerStart", DoubleValue(maxPower));
-    wifiPhy.Set("TxPowerEnd", DoubleValue(maxPower));
-    wifiPhy.Set("TxPowerLevels", UintegerValue(powerLevels));
+                                 UintegerValue(config.rtsThreshold));
+    wifiPhy.Set("TxPowerStart", DoubleValue(config.maxPower));
+    wifiPhy.Set("TxPowerEnd", DoubleValue(config.maxPower));
+    wifiPhy.Set("TxPowerLevels", UintegerValue(config.powerLevels));
     wifiPhy.Set("CcaEdThreshold", DoubleValue(-200.0));
     wifiPhy.Set("CcaSensitivity", DoubleValue(-200.0));
     //wifiPhy.Set("RxNoiseFigure", DoubleValue(7.0));
     wifiPhy.DisablePreambleDetectionModel();
     wifiPhy.Set("RxSensitivity", DoubleValue(-120.0));
-    LogComponentEnable ("PowerAdaptationDistance", LOG_LEVEL_INFO);  
+    if (!config.headless)
+    {
+        LogComponentEnable("PowerAdaptationDistance", LOG_LEVEL_INFO);
+    }
     wifiPhy.SetErrorRateModel("ns3::YansErrorRateModel");
 
 
-    Ssid ssid = Ssid("AP");
-    wifiMac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
-    wifiStaDevices.Add(wifi.Install(wifiPhy, wifiMac, wifiStaNodes.Get(0)));
+    // Each cell has its own SSID, for the STAs to associate with their AP
+    std::vector<Ssid> ssids;
+    for (uint32_t ap = 0; ap < config.nAps; ap++)
+    {
+        ssids.push_back(Ssid("AP" + std::to_string(ap)));
+        NodeContainer cell;
+        for (uint32_t sta = 0; sta < config.nStas; sta++)
+        {
+            cell.Add(wifiStaNodes.Get(ap * config.nStas + sta));
+        }
+        wifiMac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssids[ap]));
+        wifiStaDevices.Add(wifi.Install(wifiPhy, wifiMac, cell));
+    }
 
-    // Configure the AP node
-    wifi.SetRemoteStationManager(manager,
+    // Configure the AP nodes
+    wifi.SetRemoteStationManager(config.manager,
                                  "DefaultTxPowerLevel",
-                                 UintegerValue(powerLevels - 1),
+                                 UintegerValue(config.powerLevels - 1),
                                  "RtsCtsThreshold",
-                                 UintegerValue(rtsThreshold));
+                                 UintegerValue(config.rtsThreshold));
 
-    wifiMac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-    wifiApDevices.Add(wifi.Install(wifiPhy, wifiMac, wifiApNodes.Get(0)));
+    for (uint32_t ap = 0; ap < config.nAps; ap++)
+    {
+        wifiMac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssids[ap]));
+        wifiApDevices.Add(wifi.Install(wifiPhy, wifiMac, wifiApNodes.Get(ap)));
+    }
 
     wifiDevices.Add(wifiStaDevices);
     wifiDevices.Add(wifiApDevices);
 
-    // Configure the mobility.
+    // Configure the mobility. The APs are apSpacing meters apart on the x axis.
     MobilityHelper mobility;
     Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator>();
-    // Initial position of AP and STA
-    positionAlloc->Add(Vector(ap1_x, ap1_y, 0.0));
-    NS_LOG_INFO("Setting initial AP position to " << Vector(ap1_x, ap1_y, 0.0));
-    positionAlloc->Add(Vector(sta1_x, sta1_y, 0.0));
-    NS_LOG_INFO("Setting initial STA position to " << Vector(sta1_x, sta1_y, 0.0));
+    for (uint32_t ap = 0; ap < config.nAps; ap++)
+    {
+        positionAlloc->Add(Vector(config.ap1_x + ap * config.apSpacing, config.ap1_y, 0.0));
+    }
+    NS_LOG_INFO("Setting initial AP position to " << Vector(config.ap1_x, config.ap1_y, 0.0));
     mobility.SetPositionAllocator(positionAlloc);
     mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-    mobility.Install(wifiApNodes.Get(0));
-    mobility.Install(wifiStaNodes.Get(0));
+    mobility.Install(wifiApNodes);
+
+    // STAs start at the STA1 offset from their AP, or anywhere within staRadius of it
+    double offsetX = config.sta1_x - config.ap1_x;
+    double offsetY = config.sta1_y - config.ap1_y;
+    if (config.staMobility == "walk")
+    {
+        // Random walk within the area of the cells
+        double margin = std::max(config.staRadius, std::hypot(offsetX, offsetY));
+        Rectangle bounds(config.ap1_x - margin,
+                         config.ap1_x + (config.nAps - 1) * config.apSpacing + margin,
+                         config.ap1_y - margin,
+                         config.ap1_y + margin);
+        mobility.SetMobilityModel("ns3::RandomWalk2dMobilityModel",
+                                  "Bounds",
+                                  RectangleValue(bounds),
+                                  "Speed",
+                                  StringValue("ns3::ConstantRandomVariable[Constant=" +
+                                              std::to_string(config.walkSpeed) + "]"));
+    }
+    for (uint32_t ap = 0; ap < config.nAps; ap++)
+    {
+        double apX = config.ap1_x + ap * config.apSpacing;
+        NodeContainer cell;
+        for (uint32_t sta = 0; sta < config.nStas; sta++)
+        {
+            cell.Add(wifiStaNodes.Get(ap * config.nStas + sta));
+        }
+        if (config.staPlacement == "disc")
+        {
+            mobility.SetPositionAllocator("ns3::UniformDiscPositionAllocator",
+                                          "rho",
+                                          DoubleValue(config.staRadius),
+                                          "X",
+                                          DoubleValue(apX),
+                                          "Y",
+                                          DoubleValue(config.ap1_y));
+        }
+        else
+        {
+            Ptr<ListPositionAllocator> staAlloc = CreateObject<ListPositionAllocator>();
+            for (uint32_t sta = 0; sta < config.nStas; sta++)
+            {
+                staAlloc->Add(Vector(apX + offsetX, config.ap1_y + offsetY, 0.0));
+            }
+            mobility.SetPositionAllocator(staAlloc);
+        }
+        mobility.Install(cell);
+    }
+    NS_LOG_INFO("Setting initial STA position to "
+                << wifiStaNodes.Get(0)->GetObject<MobilityModel>()->GetPosition());
 
     // Statistics counter
     NodeStatistics statistics = NodeStatistics(wifiApDevices, wifiStaDevices);
+    if (config.adaptiveDwell)
+    {
+        statistics.SetAdaptiveDwell(config.dwellWindow,
+                                    config.dwellMin,
+                                    config.dwellMax,
+                                    config.dwellPrecision,
+                                    config.steps);
+    }
+    // Forks open their own files once forked
+    if (forks.empty())
+    {
+        statistics.OpenMetrics(config.metricsFile);
+        if (!config.stationsFile.empty())
+        {
+            statistics.OpenStationMetrics(config.stationsFile);
+        }
+    }
 
-    // Move the STA by stepsSize meters every stepsTime seconds
-    Simulator::Schedule(Seconds(0.5 + stepsTime),
-                        &NodeStatistics::AdvancePosition,
-                        &statistics,
-                        wifiStaNodes.Get(0),
-                        stepsSize,
-                        stepsTime);
+    // Let the rate and power managers settle before the first measurement
+    if (config.warmupTime > 0)
+    {
+        Simulator::Schedule(Seconds(0.5 + config.warmupTime),
+                            &NodeStatistics::ResetCounters,
+                            &statistics);
+    }
+
+    // Move the STAs by stepsSize meters every stepsTime seconds, or once the throughput of the
+    // step is known precisely enough. Static and walking STAs are only sampled.
+    int stepsSize = config.staMobility == "step" ? config.stepsSize : 0;
+    if (config.adaptiveDwell)
+    {
+        Simulator::Schedule(Seconds(0.5 + config.warmupTime + config.dwellWindow),
+                            &NodeStatistics::SampleWindow,
+                            &statistics,
+                            stepsSize);
+    }
+    else
+    {
+        Simulator::Schedule(Seconds(0.5 + config.warmupTime + config.stepsTime),
+                            &NodeStatistics::AdvancePosition,
+                            &statistics,
+                            stepsSize,
+                            config.stepsTime);
+    }
 
     // Configure the IP stack
     InternetStackHelper stack;
     stack.Install(wifiApNodes);
     stack.Install(wifiStaNodes);
+    // One /16 holds thousands of STAs, which come first
     Ipv4AddressHelper address;
-    address.SetBase("10.1.1.0", "255.255.255.0");
+    address.SetBase("10.1.0.0", "255.255.0.0");
     Ipv4InterfaceContainer i = address.Assign(wifiDevices);
-    Ipv4Address sinkAddress = i.GetAddress(0);
     uint16_t port = 9;
 
-    // Configure the CBR generator
-    PacketSinkHelper sink("ns3::UdpSocketFactory", InetSocketAddress(sinkAddress, port));
-    ApplicationContainer apps_sink = sink.Install(wifiStaNodes.Get(0));
+    // Configure the CBR generators, each AP shares trafficRate between the STAs of its cell
+    ApplicationContainer apps_sink;
+    ApplicationContainer apps_source;
+    for (uint32_t sta = 0; sta < wifiStaNodes.GetN(); sta++)
+    {
+        Ipv4Address sinkAddress = i.GetAddress(sta);
+        PacketSinkHelper sink("ns3::UdpSocketFactory", InetSocketAddress(sinkAddress, port));
+        apps_sink.Add(sink.Install(wifiStaNodes.Get(sta)));
 
-    OnOffHelper onoff("ns3::UdpSocketFactory", InetSocketAddress(sinkAddress, port));
-    onoff.SetConstantRate(DataRate("54Mb/s"), packetSize);
-    onoff.SetAttribute("StartTime", TimeValue(Seconds(0.5)));
-    onoff.SetAttribute("StopTime", TimeValue(Seconds(simuTime)));
-    ApplicationContainer apps_source = onoff.Install(wifiApNodes.Get(0));
+        OnOffHelper onoff("ns3::UdpSocketFactory", InetSocketAddress(sinkAddress, port));
+        onoff.SetConstantRate(DataRate(config.trafficRate * 1e6 / config.nStas), packetSize);
+        onoff.SetAttribute("StartTime", TimeValue(Seconds(0.5)));
+        onoff.SetAttribute("StopTime", TimeValue(Seconds(simuTime)));
+        apps_source.Add(onoff.Install(wifiApNodes.Get(sta / config.nStas)));
+    }
 
     apps_sink.Start(Seconds(0.5));
     apps_sink.Stop(Seconds(simuTime));
@@ -365,41 +852,183 @@ int main(int argc, char *argv[])
     //-- Setup stats and data collection
     //--------------------------------------------
 
-    // Register packet receptions to calculate throughput
-    Config::Connect("/NodeList/1/ApplicationList/*/$ns3::PacketSink/Rx",
-                    MakeCallback(&NodeStatistics::RxCallback, &statistics));
+    // Connect the traces to the devices and sinks directly, in one pass over each container,
+    // instead of resolving a Config path per AP and per STA
+    WifiTraceBinding apTraces(wifiApDevices);
+
+    // Register packet receptions to calculate throughput. Each sink is bound to the index of
+    // its STA, without context, so that no string is copied per packet.
+    WifiTraceBinding::ConnectRx(apps_sink, &NodeStatistics::StationRxCallback, &statistics);
+
+    // Register power and rate changes to calculate the Average Transmit Power. Managers
+    // without power control have no PowerChange source and are left out.
+    apTraces.ConnectPowerChange(MakeCallback(&NodeStatistics::PowerCallback, &statistics));
+    apTraces.ConnectRateChange(MakeCallback(&NodeStatistics::RateCallback, &statistics));
 
-    // Register power and rate changes to calculate the Average Transmit Power
-    Config::Connect("/NodeList/0/DeviceList/*/$ns3::WifiNetDevice/RemoteStationManager/$" +
-                        manager + "/PowerChange",
-                    MakeCallback(&NodeStatistics::PowerCallback, &statistics));
-    Config::Connect("/NodeList/0/DeviceList/*/$ns3::WifiNetDevice/RemoteStationManager/$" +
-                        manager + "/RateChange",
-                    MakeCallback(&NodeStatistics::RateCallback, &statistics));
+    apTraces.ConnectPhyTxBegin(MakeCallback(&NodeStatistics::PhyCallback, &statistics));
 
-    Config::Connect("/NodeList/0/DeviceList/*/$ns3::WifiNetDevice/Phy/PhyTxBegin",
-                    MakeCallback(&NodeStatistics::PhyCallback, &statistics));
+    // Log the association of every STA
+    apTraces.ConnectAssociatedSta(MakeCallback(&NodeStatistics::AssociationCallback, &statistics));
 
     // Callbacks to print every change of power and rate
-    Config::Connect("/NodeList/0/DeviceList/*/$ns3::WifiNetDevice/RemoteStationManager/$" +
-                        manager + "/PowerChange",
-                    MakeCallback(PowerCallback));
-    Config::Connect("/NodeList/0/DeviceList/*/$ns3::WifiNetDevice/RemoteStationManager/$" +
-                        manager + "/RateChange",
-                    MakeCallback(RateCallback));
+    apTraces.ConnectPowerChange(MakeCallback(PowerCallback));
+    apTraces.ConnectRateChange(MakeCallback(RateCallback));
 
-    // Enable pcap
-    wifiPhy.EnablePcap("wifi-power-adaptation-distance", wifiDevices);
+    // Capture the frames sent on the channel, the ring is dumped on a rate change or a
+    // throughput drop
+    PacketCapture capture;
+    capture.Setup(PacketCapture::GetMode(config.capture),
+                  config.captureFile,
+                  config.captureSnaplen,
+                  config.captureSampleN,
+                  config.captureRingSize,
+                  config.captureTriggerMbps,
+                  Seconds(config.captureDumpGap));
+    if (capture.GetMode() != PacketCapture::OFF)
+    {
+        WifiTraceBinding(wifiDevices)
+            .ConnectPhyTxBegin(MakeCallback(&PacketCapture::PhyCallback, &capture));
+    }
+    if (capture.GetMode() == PacketCapture::RING)
+    {
+        WifiTraceBinding(wifiApDevices.Get(0))
+            .ConnectRateChange(MakeCallback(&PacketCapture::RateCallback, &capture));
+        statistics.SetThroughputCallback(
+            MakeCallback(&PacketCapture::ThroughputCallback, &capture));
+    }
 
     Simulator::Stop(Seconds(simuTime));
-    Simulator::Run();
+    // Run the case, or a fork of it, to the end
+    auto finish = [&](const CaseConfig &run) {
+        perf.Start();
+        Simulator::Run();
+        perf.Stop();
+        if (!run.perfReport.empty())
+        {
+            std::ostringstream parameters;
+            parameters << "manager=" << run.manager << " steps=" << run.steps
+                       << " stepsTime=" << run.stepsTime << " stepsSize=" << run.stepsSize
+                       << " sta1_x=" << run.sta1_x << " capture=" << run.capture
+                       << " adaptiveDwell=" << run.adaptiveDwell << " rtsThreshold="
+                       << run.rtsThreshold << " trafficRate=" << run.trafficRate
+                       << " forked=" << !forks.empty();
+            perf.Write(run.perfReport, "researchCase", parameters.str());
+        }
+        asyncLog.Stop();
+        Simulator::Destroy();
+        if (run.poolStats)
+        {
+            PacketPool::PrintStats(std::cout);
+        }
+    };
+    if (forks.empty())
+    {
+        finish(config);
+        return;
+    }
+
+    // Associations, ARP and the convergence of the managers are simulated once for every fork,
+    // the log thread runs during the warm-up and is stopped right before the forks
+    WarmFork warmFork(forkWorkers);
+    uint32_t failed = warmFork.Run(
+        Seconds(0.5 + config.warmupTime),
+        forks.size(),
+        [&](uint32_t child) {
+            const CaseConfig &fork = forks[child];
+            WarmFork::Reseed(child);
+            int64_t stream = wifi.AssignStreams(wifiDevices, 0);
+            stream += mobility.AssignStreams(wifiStaNodes, stream);
+            for (uint32_t app = 0; app < apps_source.GetN(); app++)
+            {
+                Ptr<OnOffApplication> source = DynamicCast<OnOffApplication>(apps_source.Get(app));
+                stream += source->AssignStreams(stream);
+                source->SetAttribute("DataRate",
+                                     DataRateValue(DataRate(fork.trafficRate * 1e6 / fork.nStas)));
+            }
+            for (uint32_t device = 0; device < wifiDevices.GetN(); device++)
+            {
+                DynamicCast<WifiNetDevice>(wifiDevices.Get(device))
+                    ->GetRemoteStationManager()
+                    ->SetAttribute("RtsCtsThreshold", UintegerValue(fork.rtsThreshold));
+            }
+
+            statistics.ResetCounters();
+            statistics.OpenMetrics(fork.metricsFile);
+            if (!fork.stationsFile.empty())
+            {
+                statistics.OpenStationMetrics(fork.stationsFile);
+            }
+            if (!fork.headless && !fork.logFile.empty())
+            {
+                asyncLog.Start(fork.logFile);
+            }
+            finish(fork);
+            // The child exits without running the destructors
+            statistics.CloseMetrics();
+        },
+        [&asyncLog]() { asyncLog.Stop(); });
+    NS_ABORT_MSG_IF(failed > 0, failed << " forks of the case failed");
+    Simulator::Destroy();
+}
+
+/**
+ * Write the throughput and, for power control managers, the average transmit
+ * power Gnuplot files of one case.
+ *
+ * \param outputFileName The output filename suffix.
+ * \param manager The remote station manager of the AP.
+ * \param metricsFile The metrics file of the case.
+ */
+void WritePlots(const std::string &outputFileName,
+                const std::string &manager,
+                const std::string &metricsFile)
+{
+    Gnuplot2dDataset output;
+    Gnuplot2dDataset outputPower;
+    output.SetTitle("Throughput Mbits/s");
+    outputPower.SetTitle("Average Transmit Power");
+    MetricsReader reader;
+    NS_ABORT_MSG_IF(!reader.Open(metricsFile), "Cannot read metrics file " << metricsFile);
+    uint32_t distance = reader.GetColumnIndex("distance");
+    uint32_t throughput = reader.GetColumnIndex("throughput");
+    uint32_t power = reader.GetColumnIndex("power");
+    // Replicated cases have the half-width of the confidence interval of each mean
+    uint32_t throughputHalfWidth = reader.GetColumnIndex("throughputHalfWidth");
+    uint32_t powerHalfWidth = reader.GetColumnIndex("powerHalfWidth");
+    bool errorBars = throughputHalfWidth < reader.GetColumns().size();
+    if (errorBars)
+    {
+        output.SetErrorBars(Gnuplot2dDataset::Y);
+        outputPower.SetErrorBars(Gnuplot2dDataset::Y);
+    }
+    std::vector<std::vector<double>> block;
+    while (reader.ReadBlock(block))
+    {
+        for (std::size_t row = 0; row < block[distance].size(); row++)
+        {
+            if (errorBars)
+            {
+                output.Add(block[distance][row],
+                           block[throughput][row],
+                           block[throughputHalfWidth][row]);
+                outputPower.Add(block[distance][row],
+                                block[power][row],
+                                block[powerHalfWidth][row]);
+            }
+            else
+            {
+                output.Add(block[distance][row], block[throughput][row]);
+                outputPower.Add(block[distance][row], block[power][row]);
+            }
+        }
+    }
 
     std::ofstream outfile("throughput-" + outputFileName + ".plt");
     Gnuplot gnuplot = Gnuplot("throughput-" + outputFileName + ".eps", "Throughput");
     gnuplot.SetTerminal("post eps color enhanced");
     gnuplot.SetLegend("Distance [m]", "Throughput [Mbps]");
     gnuplot.SetTitle("Throughput (AP to STA) vs time");
-    gnuplot.AddDataset(statistics.GetDatafile());
+    gnuplot.AddDataset(output);
     gnuplot.GenerateOutput(outfile);
 
     if (manager == "ns3::ParfWifiManager" || manager == "ns3::AparfWifiManager" ||
@@ -410,11 +1039,737 @@ int main(int argc, char *argv[])
         gnuplot.SetTerminal("post eps color enhanced");
         gnuplot.SetLegend("Time (seconds)", "Power (mW)");
         gnuplot.SetTitle("Average transmit power (AP to STA) vs time");
-        gnuplot.AddDataset(statistics.GetPowerDatafile());
+        gnuplot.AddDataset(outputPower);
         gnuplot.GenerateOutput(outfile2);
     }
+}
 
-    Simulator::Destroy();
+/**
+ * Parse a comma-separated command-line list.
+ *
+ * \param list The list, empty to use the fallback value.
+ * \param fallback The single value used when the list is empty.
+ * \return The parsed values.
+ */
+template <typename T>
+std::vector<T> ParseList(const std::string &list, T fallback)
+{
+    std::vector<T> values;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        std::istringstream itemStream(item);
+        T value;
+        itemStream >> value;
+        NS_ABORT_MSG_IF(itemStream.fail(), "Invalid list item \"" << item << "\"");
+        values.push_back(value);
+    }
+    if (values.empty())
+    {
+        values.push_back(fallback);
+    }
+    return values;
+}
+
+/**
+ * \param name A manager name, either short (e.g. "Parf") or a full TypeId name.
+ * \return The TypeId name of the manager.
+ */
+std::string GetManagerTypeName(const std::string &name)
+{
+    if (name.find("::") != std::string::npos)
+    {
+        return name;
+    }
+    return "ns3::" + name + "WifiManager";
+}
+
+/**
+ * Write the samples of every job of a sweep into one table, one block at a time.
+ *
+ * \param fileName The table filename.
+ * \param jobs The jobs, in distance order within each case.
+ */
+void WriteSweepTable(const std::string &fileName, const std::vector<CaseConfig> &jobs)
+{
+    std::ofstream table(fileName);
+    table << "# manager maxPower minPower powerLevels rtsThreshold trafficRate distance throughput "
+             "power"
+          << std::endl;
+    for (const auto &job : jobs)
+    {
+        MetricsReader reader;
+        NS_ABORT_MSG_IF(!reader.Open(job.metricsFile),
+                        "Cannot read metrics file " << job.metricsFile);
+        uint32_t distance = reader.GetColumnIndex("distance");
+        uint32_t throughput = reader.GetColumnIndex("throughput");
+        uint32_t power = reader.GetColumnIndex("power");
+        std::vector<std::vector<double>> block;
+        while (reader.ReadBlock(block))
+        {
+            for (std::size_t row = 0; row < block[distance].size(); row++)
+            {
+                table << job.manager << " " << job.maxPower << " " << job.minPower << " "
+                      << job.powerLevels << " " << job.rtsThreshold << " " << job.trafficRate << " "
+                      << block[distance][row] << " " << block[throughput][row] << " "
+                      << block[power][row] << std::endl;
+            }
+        }
+    }
+}
+
+/**
+ * Concatenate the metrics files of the shards of a case, one block at a time.
+ *
+ * \param fileName The merged metrics filename.
+ * \param files The metrics files of the shards, in distance order.
+ */
+void MergeMetrics(const std::string &fileName, const std::vector<std::string> &files)
+{
+    MetricsSink merged;
+    for (const auto &file : files)
+    {
+        MetricsReader reader;
+        NS_ABORT_MSG_IF(!reader.Open(file), "Cannot read metrics file " << file);
+        if (!merged.IsOpen())
+        {
+            merged.Open(fileName, reader.GetColumns());
+        }
+        std::vector<std::vector<double>> block;
+        while (reader.ReadBlock(block))
+        {
+            merged.AppendBlock(block);
+        }
+    }
+}
+
+/**
+ * \param config A case, or a part of a case.
+ * \param job The index of the job simulating it.
+ * \param outputFileName The output filename suffix.
+ * \return The case with the output files of the job, which concurrent jobs must not share.
+ */
+CaseConfig GetJobConfig(const CaseConfig &config, uint32_t job, const std::string &outputFileName)
+{
+    CaseConfig jobConfig = config;
+    std::string suffix = ".job" + std::to_string(job);
+    jobConfig.metricsFile = "metrics-" + outputFileName + suffix + ".nsm";
+    if (!config.stationsFile.empty())
+    {
+        jobConfig.stationsFile = "stations-" + outputFileName + suffix + ".nsm";
+    }
+    jobConfig.captureFile = config.captureFile + suffix;
+    if (!config.logFile.empty())
+    {
+        jobConfig.logFile = config.logFile + suffix;
+    }
+    if (!config.profile.empty())
+    {
+        jobConfig.profile = config.profile + suffix;
+    }
+    return jobConfig;
+}
+
+/**
+ * Simulate the distances of every case where the throughput or the average
+ * transmit power changes, rather than all of them.
+ *
+ * Each case starts with a coarse grid, one distance every coarseSteps steps
+ * and the last one. Every interval over which the throughput or the power
+ * changes by more than tolerance times its largest value in the case is then
+ * bisected, round after round, until the intervals are one step wide. Each
+ * distance is a single-step job, the jobs of a round run on the pool.
+ *
+ * Flat intervals are not looked into, so a change that comes back to the same
+ * value within coarseSteps is missed.
+ *
+ * \param cases The cases.
+ * \param coarseSteps The steps between two distances of the coarse grid.
+ * \param tolerance The change that makes an interval bisected, relative to the largest value.
+ * \param pool The worker processes.
+ * \param outputFileName The output filename suffix.
+ * \return The jobs run, case after case in distance order.
+ */
+std::vector<CaseConfig> RunRefinement(const std::vector<CaseConfig> &cases,
+                                      uint32_t coarseSteps,
+                                      double tolerance,
+                                      ProcessPool &pool,
+                                      const std::string &outputFileName)
+{
+    std::vector<CaseConfig> jobs;
+    std::vector<std::size_t> jobCase; // Case of each job
+    // Throughput and power at each simulated step of each case, by step index
+    std::vector<std::map<uint32_t, std::pair<double, double>>> samples(cases.size());
+    std::vector<std::pair<std::size_t, uint32_t>> pending;
+    for (std::size_t c = 0; c < cases.size(); c++)
+    {
+        for (uint32_t step = 0; step < cases[c].steps; step += coarseSteps)
+        {
+            pending.emplace_back(c, step);
+        }
+        if ((cases[c].steps - 1) % coarseSteps != 0)
+        {
+            pending.emplace_back(c, cases[c].steps - 1);
+        }
+    }
+
+    for (uint32_t round = 1; !pending.empty(); round++)
+    {
+        std::size_t first = jobs.size();
+        for (const auto &[c, step] : pending)
+        {
+            CaseConfig job = GetJobConfig(cases[c], jobs.size(), outputFileName);
+            job.sta1_x = cases[c].sta1_x + step * cases[c].stepsSize;
+            job.steps = 1;
+            jobs.push_back(job);
+            jobCase.push_back(c);
+        }
+        std::cout << "Refinement round " << round << ": " << pending.size() << " distances"
+                  << std::endl;
+        pool.Run(pending.size(), [&jobs, first](uint32_t job) {
+            RunCase(jobs[first + job]);
+            return std::string();
+        });
+
+        for (std::size_t j = 0; j < pending.size(); j++)
+        {
+            MetricsReader reader;
+            NS_ABORT_MSG_IF(!reader.Open(jobs[first + j].metricsFile),
+                            "Cannot read metrics file " << jobs[first + j].metricsFile);
+            std::vector<std::vector<double>> block;
+            NS_ABORT_MSG_IF(!reader.ReadBlock(block) || block[0].empty(),
+                            "No step in metrics file " << jobs[first + j].metricsFile);
+            samples[pending[j].first][pending[j].second] = {
+                block[reader.GetColumnIndex("throughput")][0],
+                block[reader.GetColumnIndex("power")][0]};
+        }
+
+        pending.clear();
+        for (std::size_t c = 0; c < cases.size(); c++)
+        {
+            double maxThroughput = 0;
+            double maxPower = 0;
+            for (const auto &sample : samples[c])
+            {
+                maxThroughput = std::max(maxThroughput, sample.second.first);
+                maxPower = std::max(maxPower, sample.second.second);
+            }
+            for (auto a = samples[c].begin(), b = std::next(a); b != samples[c].end(); a = b++)
+            {
+                if (b->first - a->first > 1 &&
+                    (std::abs(b->second.first - a->second.first) > tolerance * maxThroughput ||
+                     std::abs(b->second.second - a->second.second) > tolerance * maxPower))
+                {
+                    pending.emplace_back(c, (a->first + b->first) / 2);
+                }
+            }
+        }
+    }
+
+    // Back in case then distance order, for the metrics to be merged
+    std::vector<std::size_t> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&jobs, &jobCase](std::size_t a, std::size_t b) {
+        return jobCase[a] != jobCase[b] ? jobCase[a] < jobCase[b] : jobs[a].sta1_x < jobs[b].sta1_x;
+    });
+    std::vector<CaseConfig> sorted;
+    uint32_t allSteps = 0;
+    for (std::size_t job : order)
+    {
+        sorted.push_back(jobs[job]);
+    }
+    for (const auto &sweepCase : cases)
+    {
+        allSteps += sweepCase.steps;
+    }
+    std::cout << "Refined to " << jobs.size() << " distances out of " << allSteps << std::endl;
+    return sorted;
+}
+
+/**
+ * Run replications of a case until the throughput and average transmit power
+ * of every step are precise enough, and write their means and the half-widths
+ * of their confidence intervals to the metrics file of the case.
+ *
+ * Each replication has its own output files, its per-STA rows are not kept.
+ *
+ * \param config The case.
+ * \param runner The replication runner.
+ * \param outputFileName The output filename suffix.
+ */
+void RunReplications(const CaseConfig &config,
+                     ReplicationRunner &runner,
+                     const std::string &outputFileName)
+{
+    if (runner.Fork())
+    {
+        CaseConfig replication = GetJobConfig(config, runner.GetReplication(), outputFileName);
+        replication.stationsFile = "";
+        RunCase(replication);
+
+        std::vector<std::string> names;
+        std::vector<double> values;
+        MetricsReader reader;
+        NS_ABORT_MSG_IF(!reader.Open(replication.metricsFile),
+                        "Cannot read metrics file " << replication.metricsFile);
+        uint32_t distance = reader.GetColumnIndex("distance");
+        uint32_t throughput = reader.GetColumnIndex("throughput");
+        uint32_t power = reader.GetColumnIndex("power");
+        uint32_t step = 0;
+        std::vector<std::vector<double>> block;
+        while (reader.ReadBlock(block))
+        {
+            for (std::size_t row = 0; row < block[distance].size(); row++, step++)
+            {
+                std::string prefix = "step " + std::to_string(step) + " ";
+                names.push_back(prefix + "distance");
+                values.push_back(block[distance][row]);
+                names.push_back(prefix + "throughput");
+                values.push_back(block[throughput][row]);
+                names.push_back(prefix + "power");
+                values.push_back(block[power][row]);
+            }
+        }
+        std::remove(replication.metricsFile.c_str());
+        runner.Submit(names, values);
+    }
+
+    MetricsSink metrics;
+    metrics.Open(config.metricsFile,
+                 {"distance", "throughput", "power", "throughputHalfWidth", "powerHalfWidth"});
+    const std::vector<std::string> &names = runner.GetNames();
+    for (uint32_t step = 0;; step++)
+    {
+        std::string prefix = "step " + std::to_string(step) + " ";
+        if (std::find(names.begin(), names.end(), prefix + "distance") == names.end())
+        {
+            break;
+        }
+        const RunningStats &throughput = runner.GetStats(prefix + "throughput");
+        const RunningStats &power = runner.GetStats(prefix + "power");
+        metrics.Append({runner.GetStats(prefix + "distance").GetMean(),
+                        throughput.GetMean(),
+                        power.GetMean(),
+                        throughput.GetHalfWidth(),
+                        power.GetHalfWidth()});
+    }
+    metrics.Close();
+    std::cout << runner.GetNReplications() << " replications, precision "
+              << (runner.IsPrecise() ? "reached" : "not reached") << std::endl;
+}
+
+/**
+ * Run the jobs of a sweep, warming up once every group of consecutive jobs
+ * that differ only in their RTS threshold and traffic rate, and forking the
+ * jobs of the group from it.
+ *
+ * The groups run on a pool of worker processes, and the forks of a group share
+ * the cores left to it.
+ *
+ * \param jobs The jobs, one per case.
+ * \param workers Number of processes running at once.
+ */
+void RunForkedJobs(const std::vector<CaseConfig> &jobs, uint32_t workers)
+{
+    std::vector<std::pair<std::size_t, std::size_t>> groups; // First and past-the-last job
+    for (std::size_t job = 0; job < jobs.size(); job++)
+    {
+        const CaseConfig *first = groups.empty() ? nullptr : &jobs[groups.back().first];
+        if (first && first->manager == jobs[job].manager &&
+            first->maxPower == jobs[job].maxPower && first->minPower == jobs[job].minPower &&
+            first->powerLevels == jobs[job].powerLevels)
+        {
+            groups.back().second = job + 1;
+        }
+        else
+        {
+            groups.emplace_back(job, job + 1);
+        }
+    }
+
+    ProcessPool groupPool(std::min<uint32_t>(workers, groups.size()));
+    uint32_t forkWorkers = std::max<uint32_t>(1, workers / groupPool.GetNWorkers());
+    std::cout << "Running " << jobs.size() << " jobs forked from " << groups.size()
+              << " warm-ups on " << workers << " workers" << std::endl;
+    groupPool.Run(groups.size(), [&jobs, &groups, forkWorkers](uint32_t group) {
+        std::vector<CaseConfig> forks(jobs.begin() + groups[group].first,
+                                      jobs.begin() + groups[group].second);
+        RunCase(forks.front(), forks, forkWorkers);
+        return std::string();
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    double maxPower = 20;
+    double minPower = 20;
+    uint32_t powerLevels = 1;
+
+    uint32_t rtsThreshold = 2346;
+    double trafficRate = 54;
+    std::string manager = "ns3::ParfWifiManager";
+    std::string outputFileName = "parf";
+    int ap1_x = 0;
+    int ap1_y = 0;
+    int sta1_x = 5;
+    int sta1_y = 0;
+    uint32_t nAps = 1;
+    uint32_t nStas = 1;
+    double apSpacing = 50;
+    std::string staPlacement = "offset";
+    double staRadius = 10;
+    std::string staMobility = "step";
+    double walkSpeed = 1;
+    uint32_t steps = 260;
+    uint32_t stepsSize = 1;
+    uint32_t stepsTime = 1;
+    bool adaptiveDwell = false;
+    double dwellWindow = 0.1;
+    double dwellMin = 0.5;
+    double dwellMax = 0;
+    double dwellPrecision = 0.05;
+
+    std::string sweepManagers = "";
+    std::string sweepMaxPower = "";
+    std::string sweepMinPower = "";
+    std::string sweepPowerLevels = "";
+    std::string sweepRtsThreshold = "";
+    std::string sweepTrafficRate = "";
+    bool fork = false;
+    uint32_t replications = 1;
+    uint32_t minReplications = 3;
+    double replicationPrecision = 0.05;
+    uint32_t workers = 0;
+    uint32_t shardSteps = 0;
+    uint32_t refineSteps = 0;
+    double refineTolerance = 0.05;
+    double warmupTime = 0;
+    std::string capture = "off";
+    uint32_t captureSnaplen = 128;
+    uint32_t captureSampleN = 100;
+    uint32_t captureRingSize = 1024;
+    double captureTriggerMbps = 0;
+    double captureDumpGap = 1;
+    bool headless = false;
+    std::string perfReport = "";
+    std::string logSink = "text";
+    std::string logFile = "researchCase.nslog";
+    std::string profile = "";
+    std::string scheduler = "map";
+    bool packetPool = false;
+    bool poolStats = false;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("manager", "PRC Manager", manager);
+    cmd.AddValue("rtsThreshold", "RTS threshold", rtsThreshold);
+    cmd.AddValue("trafficRate", "CBR traffic of each AP, shared by its STAs [Mbps]", trafficRate);
+    cmd.AddValue("outputFileName", "Output filename", outputFileName);
+    cmd.AddValue("steps", "How many different distances to try", steps);
+    cmd.AddValue("stepsTime", "Time on each step", stepsTime);
+    cmd.AddValue("stepsSize", "Distance between steps", stepsSize);
+    cmd.AddValue("adaptiveDwell",
+                 "Stay on each step until its throughput is precise enough rather than stepsTime",
+                 adaptiveDwell);
+    cmd.AddValue("dwellWindow", "Throughput sampling window of the adaptive dwell [s]", dwellWindow);
+    cmd.AddValue("dwellMin", "Shortest adaptive dwell [s]", dwellMin);
+    cmd.AddValue("dwellMax", "Longest adaptive dwell, 0 for stepsTime [s]", dwellMax);
+    cmd.AddValue("dwellPrecision",
+                 "Half-width of the 95% confidence interval of the throughput, relative to its "
+                 "mean, ending an adaptive step",
+                 dwellPrecision);
+    cmd.AddValue("maxPower", "Maximum available transmission level (dbm).", maxPower);
+    cmd.AddValue("minPower", "Minimum available transmission level (dbm).", minPower);
+    cmd.AddValue("powerLevels",
+                 "Number of transmission power levels available between "
+                 "TxPowerStart and TxPowerEnd included.",
+                 powerLevels);
+    cmd.AddValue("AP1_x", "Position of AP1 in x coordinate", ap1_x);
+    cmd.AddValue("AP1_y", "Position of AP1 in y coordinate", ap1_y);
+    cmd.AddValue("STA1_x", "Position of STA1 in x coordinate", sta1_x);
+    cmd.AddValue("STA1_y", "Position of STA1 in y coordinate", sta1_y);
+    cmd.AddValue("nAps", "Number of APs, apSpacing apart on the x axis from AP1", nAps);
+    cmd.AddValue("nStas", "Number of STAs per AP", nStas);
+    cmd.AddValue("apSpacing", "Distance between two APs [m]", apSpacing);
+    cmd.AddValue("staPlacement",
+                 "STA placement: offset (at the STA1 offset from their AP) or disc (uniform "
+                 "within staRadius of their AP)",
+                 staPlacement);
+    cmd.AddValue("staRadius", "Radius of the disc placement [m]", staRadius);
+    cmd.AddValue("staMobility",
+                 "STA mobility: step (stepsSize further every step), static or walk (random "
+                 "walk at walkSpeed)",
+                 staMobility);
+    cmd.AddValue("walkSpeed", "Speed of the walking STAs [m/s]", walkSpeed);
+    cmd.AddValue("sweepManagers",
+                 "Comma-separated PRC managers to sweep (e.g. Parf,Aparf,Rrpaa,Minstrel)",
+                 sweepManagers);
+    cmd.AddValue("sweepMaxPower", "Comma-separated maxPower values to sweep", sweepMaxPower);
+    cmd.AddValue("sweepMinPower", "Comma-separated minPower values to sweep", sweepMinPower);
+    cmd.AddValue("sweepPowerLevels",
+                 "Comma-separated powerLevels values to sweep",
+                 sweepPowerLevels);
+    cmd.AddValue("sweepRtsThreshold",
+                 "Comma-separated rtsThreshold values to sweep",
+                 sweepRtsThreshold);
+    cmd.AddValue("sweepTrafficRate",
+                 "Comma-separated trafficRate values to sweep",
+                 sweepTrafficRate);
+    cmd.AddValue("fork",
+                 "Warm up the cases that differ only in rtsThreshold and trafficRate once, then "
+                 "fork each one from the warmed-up simulation",
+                 fork);
+    cmd.AddValue("workers", "Number of sweep worker processes (0 uses every core)", workers);
+    cmd.AddValue("shardSteps",
+                 "Run every block of shardSteps distances as its own simulation (0 disables)",
+                 shardSteps);
+    cmd.AddValue("refineSteps",
+                 "Simulate one distance every refineSteps steps, then bisect the intervals where "
+                 "the throughput or power changes, down to one step (0 simulates every step)",
+                 refineSteps);
+    cmd.AddValue("refineTolerance",
+                 "Change over an interval that makes it bisected, relative to the largest "
+                 "throughput or power of the case",
+                 refineTolerance);
+    cmd.AddValue("replications",
+                 "Most independent replications of the case, each on its own RNG run (1 disables)",
+                 replications);
+    cmd.AddValue("minReplications", "Replications before the precision is checked", minReplications);
+    cmd.AddValue("replicationPrecision",
+                 "Half-width of the 95% confidence interval of every step throughput and power, "
+                 "relative to its mean, ending the replications",
+                 replicationPrecision);
+    cmd.AddValue("warmupTime", "Time before the first step is measured", warmupTime);
+    cmd.AddValue("capture", "Packet capture level: off, header, sampled or ring", capture);
+    cmd.AddValue("captureSnaplen", "Bytes kept per captured frame", captureSnaplen);
+    cmd.AddValue("captureSampleN", "Capture one frame in captureSampleN (sampled)", captureSampleN);
+    cmd.AddValue("captureRingSize", "Frames kept in memory until a trigger (ring)", captureRingSize);
+    cmd.AddValue("captureTriggerMbps",
+                 "Dump the ring when a step throughput is below this value (ring, 0 disables)",
+                 captureTriggerMbps);
+    cmd.AddValue("captureDumpGap",
+                 "Least time between two ring dumps on a rate change (ring) [s]",
+                 captureDumpGap);
+    cmd.AddValue("headless", "Disable logging and packet capture", headless);
+    cmd.AddValue("perfReport", "Append a performance report of every run to this file", perfReport);
+    cmd.AddValue("logSink",
+                 "Logs: text (std::clog) or async (binary file written by a background thread, "
+                 "see log-format)",
+                 logSink);
+    cmd.AddValue("logFile", "Binary log file (async), one per job when sweeping", logFile);
+    cmd.AddValue("profile",
+                 "Profile the events by target function, the report is written to this file "
+                 "(one per job when sweeping)",
+                 profile);
+    cmd.AddValue("scheduler", "Event scheduler: map, heap, list, calendar or ladder", scheduler);
+    cmd.AddValue("packetPool",
+                 "Serve the packets, buffers, tags and events from thread-local slab pools",
+                 packetPool);
+    cmd.AddValue("poolStats", "Print the allocation counters of every run", poolStats);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF((packetPool || poolStats) && !PacketPool::IsAvailable(),
+                    "packetPool and poolStats need a build with PACKET_POOL_REPLACE_NEW defined");
+    NS_ABORT_MSG_IF(logSink != "text" && logSink != "async", "logSink must be text or async");
+    NS_ABORT_MSG_IF(adaptiveDwell && dwellWindow <= 0, "dwellWindow must be positive");
+    NS_ABORT_MSG_IF(nAps == 0 || nStas == 0, "nAps and nStas must be positive");
+    NS_ABORT_MSG_IF(staPlacement != "offset" && staPlacement != "disc",
+                    "staPlacement must be offset or disc");
+    NS_ABORT_MSG_IF(staMobility != "step" && staMobility != "static" && staMobility != "walk",
+                    "staMobility must be step, static or walk");
+    NS_ABORT_MSG_IF((shardSteps > 0 || refineSteps > 0) &&
+                        (staPlacement != "offset" || staMobility != "step"),
+                    "shardSteps and refineSteps split the distance steps, they need "
+                    "staPlacement=offset and staMobility=step");
+    NS_ABORT_MSG_IF(fork && (shardSteps > 0 || refineSteps > 0),
+                    "fork runs whole cases, it cannot be combined with shardSteps or refineSteps");
+    NS_ABORT_MSG_IF(fork && (capture != "off" || !profile.empty()),
+                    "The capture and profile files would be shared by the forks");
+    NS_ABORT_MSG_IF(fork && warmupTime <= 0,
+                    "fork starts the runs from the end of the warm-up, warmupTime must be positive");
+
+    if (headless)
+    {
+        capture = "off";
+    }
+    else
+    {
+        LogComponentEnable("AarfWifiManager", LOG_LEVEL_INFO);
+        LogComponentEnable("MinstrelWifiManager", LOG_LEVEL_INFO);
+    }
+
+    if (steps == 0)
+    {
+        std::cout << "Exiting without running simulation; steps value of 0" << std::endl;
+        return 0;
+    }
+
+    CaseConfig config;
+    config.manager = manager;
+    config.maxPower = maxPower;
+    config.minPower = minPower;
+    config.powerLevels = powerLevels;
+    config.rtsThreshold = rtsThreshold;
+    config.trafficRate = trafficRate;
+    config.ap1_x = ap1_x;
+    config.ap1_y = ap1_y;
+    config.sta1_x = sta1_x;
+    config.sta1_y = sta1_y;
+    config.nAps = nAps;
+    config.nStas = nStas;
+    config.apSpacing = apSpacing;
+    config.staPlacement = staPlacement;
+    config.staRadius = staRadius;
+    config.staMobility = staMobility;
+    config.walkSpeed = walkSpeed;
+    config.steps = steps;
+    config.stepsSize = stepsSize;
+    config.stepsTime = stepsTime;
+    config.adaptiveDwell = adaptiveDwell;
+    config.dwellWindow = dwellWindow;
+    config.dwellMin = dwellMin;
+    config.dwellMax = dwellMax > 0 ? dwellMax : stepsTime;
+    config.dwellPrecision = dwellPrecision;
+    config.warmupTime = warmupTime;
+    config.metricsFile = "metrics-" + outputFileName + ".nsm";
+    // Per-STA rows only when there is more than the single STA of the metrics file
+    config.stationsFile = nAps * nStas > 1 ? "stations-" + outputFileName + ".nsm" : "";
+    config.capture = capture;
+    config.captureFile = "wifi-power-adaptation-distance";
+    config.captureSnaplen = captureSnaplen;
+    config.captureSampleN = captureSampleN;
+    config.captureRingSize = captureRingSize;
+    config.captureTriggerMbps = captureTriggerMbps;
+    config.captureDumpGap = captureDumpGap;
+    config.headless = headless;
+    config.perfReport = perfReport;
+    config.logFile = logSink == "async" ? logFile : "";
+    config.profile = profile;
+    config.scheduler = scheduler;
+    config.packetPool = packetPool;
+    config.poolStats = poolStats;
+    // Fail before any job is forked
+    PacketCapture::GetMode(capture);
+
+    bool sweep = !sweepManagers.empty() || !sweepMaxPower.empty() || !sweepMinPower.empty() ||
+                 !sweepPowerLevels.empty() || !sweepRtsThreshold.empty() ||
+                 !sweepTrafficRate.empty();
+    NS_ABORT_MSG_IF(replications > 1 && (sweep || shardSteps > 0 || refineSteps > 0),
+                    "Only a single case is replicated, without sweep, shardSteps or refineSteps");
+    if (!sweep && shardSteps == 0 && refineSteps == 0)
+    {
+        if (replications > 1)
+        {
+            ReplicationRunner runner(minReplications,
+                                     replications,
+                                     replicationPrecision,
+                                     workers);
+            RunReplications(config, runner, outputFileName);
+        }
+        else
+        {
+            RunCase(config);
+        }
+        WritePlots(outputFileName, manager, config.metricsFile);
+        return 0;
+    }
+
+    // Every combination of the swept values is one case of the grid
+    std::vector<CaseConfig> cases;
+    for (const auto &sweepManager : ParseList<std::string>(sweepManagers, manager))
+    {
+        for (double sweepMax : ParseList<double>(sweepMaxPower, maxPower))
+        {
+            for (double sweepMin : ParseList<double>(sweepMinPower, minPower))
+            {
+                for (uint32_t levels : ParseList<uint32_t>(sweepPowerLevels, powerLevels))
+                {
+                    // The forkable parameters come last, their cases follow each other
+                    for (uint32_t rts : ParseList<uint32_t>(sweepRtsThreshold, rtsThreshold))
+                    {
+                        for (double rate : ParseList<double>(sweepTrafficRate, trafficRate))
+                        {
+                            CaseConfig sweepCase = config;
+                            sweepCase.manager = GetManagerTypeName(sweepManager);
+                            sweepCase.maxPower = sweepMax;
+                            sweepCase.minPower = sweepMin;
+                            sweepCase.powerLevels = levels;
+                            sweepCase.rtsThreshold = rts;
+                            sweepCase.trafficRate = rate;
+                            cases.push_back(sweepCase);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    ProcessPool pool(workers);
+    std::vector<CaseConfig> jobs;
+    if (refineSteps > 0)
+    {
+        jobs = RunRefinement(cases, refineSteps, refineTolerance, pool, outputFileName);
+    }
+    else
+    {
+        // Split every case into shards of consecutive distances, each one simulated on its own
+        for (std::size_t c = 0; c < cases.size(); c++)
+        {
+            uint32_t blockSteps = shardSteps == 0 ? cases[c].steps : shardSteps;
+            for (uint32_t first = 0; first < cases[c].steps; first += blockSteps)
+            {
+                CaseConfig shard = GetJobConfig(cases[c], jobs.size(), outputFileName);
+                shard.sta1_x = cases[c].sta1_x + first * cases[c].stepsSize;
+                shard.steps = std::min(blockSteps, cases[c].steps - first);
+                jobs.push_back(shard);
+            }
+        }
+
+        if (fork)
+        {
+            RunForkedJobs(jobs, pool.GetNWorkers());
+        }
+        else
+        {
+            std::cout << "Running " << jobs.size() << " jobs on " << pool.GetNWorkers()
+                      << " workers" << std::endl;
+            pool.Run(jobs.size(), [&jobs](uint32_t job) {
+                RunCase(jobs[job]);
+                return std::string();
+            });
+        }
+    }
+
+    // Jobs are in distance order within each case, stitch them back into their case
+    if (sweep)
+    {
+        WriteSweepTable("sweep-" + outputFileName + ".dat", jobs);
+    }
+    else
+    {
+        std::vector<std::string> metricsFiles;
+        std::vector<std::string> stationsFiles;
+        for (const auto &job : jobs)
+        {
+            metricsFiles.push_back(job.metricsFile);
+            stationsFiles.push_back(job.stationsFile);
+        }
+        MergeMetrics(config.metricsFile, metricsFiles);
+        WritePlots(outputFileName, manager, config.metricsFile);
+        if (!config.stationsFile.empty())
+        {
+            MergeMetrics(config.stationsFile, stationsFiles);
+            for (const auto &file : stationsFiles)
+            {
+                std::remove(file.c_str());
+            }
+        }
+    }
+    // The stations files of a sweep are kept, one per job
+    for (const auto &job : jobs)
+    {
+        std::remove(job.metricsFile.c_str());
+    }
 
     return 0;
 }
@@ -0,0 +1,207 @@
+#ifndef ROUTE_TRACKER_H
+#define ROUTE_TRACKER_H
+
+#include "ns3/abort.h"
+#include "ns3/ipv4.h"
+#include "ns3/node-list.h"
+#include "ns3/node.h"
+#include "ns3/output-stream-wrapper.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Records the changes of the IPv4 routing tables instead of full dumps.
+ *
+ * AnimationInterface::EnableIpv4RouteTracking() writes the complete table of
+ * every node at every poll. RouteTracker keeps the last table of each node,
+ * as printed by its routing protocol, and only writes the routes that were
+ * added (+), removed (-) or changed (~, same destination and mask) since. The
+ * first time a node is tracked all its routes are added, which makes the
+ * full snapshot at start.
+ *
+ * Tables can be polled at a fixed interval with Poll(), or tracked on
+ * routing change events by connecting Track() to a source of changed nodes,
+ * e.g. RoutingCache::AddRoutesChangedCallback(), so that the cost follows the
+ * churn rather than nodes x routes x polls.
+ *
+ * Each line of the file is: time [s], node id, +, - or ~, route.
+ */
+class RouteTracker
+{
+  public:
+    /**
+     * Create the tracking file.
+     *
+     * \param fileName The tracking filename.
+     */
+    RouteTracker(const std::string &fileName);
+
+    /**
+     * Compare the tables of every node to their last state at a fixed interval.
+     *
+     * \param start Time of the first poll.
+     * \param stop Time after which polling stops.
+     * \param interval Time between two polls.
+     */
+    void Poll(Time start, Time stop, Time interval);
+    /**
+     * Write the changes of the table of a node since it was last tracked.
+     *
+     * \param node The node.
+     */
+    void Track(Ptr<Node> node);
+    /// Write the changes of the tables of every node
+    void TrackAll();
+
+    /// \return The number of route changes written
+    uint64_t GetNChanges() const;
+
+  private:
+    /**
+     * \param stop Time after which polling stops.
+     * \param interval Time between two polls.
+     */
+    void DoPoll(Time stop, Time interval);
+    /**
+     * \param node A node.
+     * \return The routes of the node as printed by its routing protocol, sorted.
+     */
+    static std::vector<std::string> GetRoutes(Ptr<Node> node);
+    /**
+     * \param route A route line.
+     * \return Its destination and mask, the first and third columns.
+     */
+    static std::string GetKey(const std::string &route);
+
+    std::ofstream m_file;                                  //!< Tracking file
+    std::map<uint32_t, std::vector<std::string>> m_tables; //!< Last routes of each node
+    uint64_t m_nChanges;                                   //!< Route changes written
+};
+
+inline RouteTracker::RouteTracker(const std::string &fileName)
+    : m_nChanges(0)
+{
+    m_file.open(fileName, std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_file, "Cannot open route tracking file " << fileName);
+}
+
+inline uint64_t RouteTracker::GetNChanges() const
+{
+    return m_nChanges;
+}
+
+inline void RouteTracker::Poll(Time start, Time stop, Time interval)
+{
+    Simulator::Schedule(start, &RouteTracker::DoPoll, this, stop, interval);
+}
+
+inline void RouteTracker::DoPoll(Time stop, Time interval)
+{
+    TrackAll();
+    if (Simulator::Now() + interval <= stop)
+    {
+        Simulator::Schedule(interval, &RouteTracker::DoPoll, this, stop, interval);
+    }
+}
+
+inline void RouteTracker::TrackAll()
+{
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); n++)
+    {
+        Track(NodeList::GetNode(n));
+    }
+}
+
+inline std::vector<std::string> RouteTracker::GetRoutes(Ptr<Node> node)
+{
+    std::vector<std::string> routes;
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+    if (!ipv4 || !ipv4->GetRoutingProtocol())
+    {
+        return routes;
+    }
+    std::ostringstream table;
+    ipv4->GetRoutingProtocol()->PrintRoutingTable(Create<OutputStreamWrapper>(&table));
+    // Skip the headers, which hold the time, and keep the routes
+    std::istringstream lines(table.str());
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.empty() || line.compare(0, 5, "Node:") == 0 ||
+            line.compare(0, 11, "Destination") == 0 || line.find("Priority:") != std::string::npos)
+        {
+            continue;
+        }
+        routes.push_back(line);
+    }
+    std::sort(routes.begin(), routes.end());
+    return routes;
+}
+
+inline std::string RouteTracker::GetKey(const std::string &route)
+{
+    std::istringstream columns(route);
+    std::string destination;
+    std::string gateway;
+    std::string mask;
+    columns >> destination >> gateway >> mask;
+    return destination + " " + mask;
+}
+
+inline void RouteTracker::Track(Ptr<Node> node)
+{
+    std::vector<std::string> routes = GetRoutes(node);
+    std::vector<std::string> &last = m_tables[node->GetId()];
+    if (routes == last)
+    {
+        return;
+    }
+    std::vector<std::string> removed;
+    std::vector<std::string> added;
+    std::set_difference(last.begin(), last.end(), routes.begin(), routes.end(),
+                        std::back_inserter(removed));
+    std::set_difference(routes.begin(), routes.end(), last.begin(), last.end(),
+                        std::back_inserter(added));
+
+    // A destination removed and added once is a changed route
+    std::map<std::string, int> keys;
+    for (const auto &route : removed)
+    {
+        keys[GetKey(route)] += 1;
+    }
+    for (const auto &route : added)
+    {
+        keys[GetKey(route)] += 2;
+    }
+    double now = Simulator::Now().GetSeconds();
+    for (const auto &route : removed)
+    {
+        if (keys[GetKey(route)] != 3)
+        {
+            m_file << now << " " << node->GetId() << " - " << route << "\n";
+            m_nChanges++;
+        }
+    }
+    for (const auto &route : added)
+    {
+        m_file << now << " " << node->GetId() << (keys[GetKey(route)] == 3 ? " ~ " : " + ")
+               << route << "\n";
+        m_nChanges++;
+    }
+    m_file.flush();
+    last.swap(routes);
+}
+
+} // namespace ns3
+
+#endif /* ROUTE_TRACKER_H */
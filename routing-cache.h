@@ -0,0 +1,621 @@
+#ifndef ROUTING_CACHE_H
+#define ROUTING_CACHE_H
+
+#include "ns3/abort.h"
+#include "ns3/bridge-net-device.h"
+#include "ns3/callback.h"
+#include "ns3/channel.h"
+#include "ns3/global-route-manager-impl.h"
+#include "ns3/global-router-interface.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/ipv4-global-routing.h"
+#include "ns3/ipv4-list-routing.h"
+#include "ns3/ipv4-routing-table-entry.h"
+#include "ns3/ipv4.h"
+#include "ns3/net-device.h"
+#include "ns3/node-list.h"
+#include "ns3/simulation-singleton.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <unistd.h>
+
+namespace ns3
+{
+
+/**
+ * \brief Global routing with a route cache and incremental updates.
+ *
+ * Populate() reloads the routes of every node from a cache file when the
+ * topology hash stored in the file matches the current topology, and only
+ * runs the full SPF of Ipv4GlobalRoutingHelper::PopulateRoutingTables() on a
+ * miss, saving the result for the next run.
+ *
+ * SetInterfaceState() brings an interface down or up at run time. Taking a
+ * link away can only change the shortest path tree of a router if the link is
+ * part of it, so on a link down the routes of every router are kept, the link
+ * state database is rebuilt, and SPF only runs again from the routers that
+ * had a route through the link: a next hop on its channel, on a channel
+ * bridged to it, or at one of its addresses. Bringing a link up may shorten
+ * any path, so every router is recomputed. SetCheckFullSpf() compares the
+ * incremental routes with a full SPF after each link down.
+ *
+ * Routes are only the host and network routes computed by the global routing
+ * SPF; AS external routes injected with GlobalRouter::InjectRoute are not
+ * cached.
+ */
+class RoutingCache
+{
+  public:
+    /// Callback invoked with a node whose global routes changed
+    typedef Callback<void, Ptr<Node>> RoutesChangedCallback;
+
+    RoutingCache();
+
+    /**
+     * Set up the global routes of every node, from the cache file when it
+     * matches the topology.
+     *
+     * \param fileName The cache filename, empty to always run the full SPF.
+     * \return True if the routes were loaded from the cache.
+     */
+    bool Populate(const std::string &fileName);
+
+    /**
+     * Bring an interface down or up and update the global routes.
+     *
+     * \param node The node.
+     * \param interface The Ipv4 interface index.
+     * \param up True to bring the interface up.
+     */
+    void SetInterfaceState(Ptr<Node> node, uint32_t interface, bool up);
+
+    /**
+     * \param callback Called for each node whose routes are set or changed.
+     */
+    void AddRoutesChangedCallback(RoutesChangedCallback callback);
+
+    /// \return The number of routers whose SPF ran during the last update
+    uint32_t GetNRecomputed() const;
+
+    /**
+     * \param check True to run a full SPF after each link down and abort if
+     *        the incremental routes of a node differ from it.
+     */
+    void SetCheckFullSpf(bool check);
+
+    /**
+     * FNV-1a hash of what the global routes depend on: nodes, devices,
+     * channels, interface addresses, states and metrics.
+     *
+     * \return The topology hash.
+     */
+    static uint64_t GetTopologyHash();
+
+    /**
+     * \param node A node.
+     * \return The global routing protocol of the node, or 0 if it has none.
+     */
+    static Ptr<Ipv4GlobalRouting> GetGlobalRouting(Ptr<Node> node);
+
+  private:
+    /// A global route, addresses in host byte order
+    struct Route
+    {
+        uint32_t dest;      ///< Destination host or network
+        uint32_t mask;      ///< Destination mask, all ones for a host route
+        uint32_t gateway;   ///< Next hop, 0 if the destination is on link
+        uint32_t interface; ///< Output interface
+    };
+
+    typedef std::vector<Route> RouteTable;
+
+    /**
+     * \param routing A global routing protocol.
+     * \return Its routes.
+     */
+    static RouteTable GetRoutes(Ptr<Ipv4GlobalRouting> routing);
+    /**
+     * Add routes to a global routing protocol.
+     *
+     * \param routing The global routing protocol.
+     * \param table The routes.
+     */
+    static void AddRoutes(Ptr<Ipv4GlobalRouting> routing, const RouteTable &table);
+    /**
+     * \param table A route table.
+     * \param dest A destination.
+     * \return The longest prefix route to the destination, or 0 if there is none.
+     */
+    static const Route *Lookup(const RouteTable &table, uint32_t dest);
+    /**
+     * \param table A route table.
+     * \return The table in a canonical order.
+     */
+    static RouteTable Sorted(RouteTable table);
+    /**
+     * \param channel A channel.
+     * \return The ids of the channel and of every channel joined to it by bridges.
+     */
+    static std::unordered_set<uint32_t> GetBridgedChannels(Ptr<Channel> channel);
+    /// Abort if the routes of a node differ from those of a full SPF
+    void CheckFullSpf() const;
+
+    /**
+     * \param fileName The cache filename.
+     * \param hash The topology hash.
+     * \return True if the file matched the hash and its routes were added.
+     */
+    bool Load(const std::string &fileName, uint64_t hash);
+    /**
+     * \param fileName The cache filename.
+     * \param hash The topology hash.
+     */
+    void Save(const std::string &fileName, uint64_t hash) const;
+    /**
+     * \param node A node.
+     */
+    void NotifyRoutesChanged(Ptr<Node> node) const;
+
+    std::vector<RoutesChangedCallback> m_callbacks;
+    uint32_t m_nRecomputed;
+    bool m_checkFullSpf;
+};
+
+inline RoutingCache::RoutingCache()
+    : m_nRecomputed(0),
+      m_checkFullSpf(false)
+{
+}
+
+inline void RoutingCache::SetCheckFullSpf(bool check)
+{
+    m_checkFullSpf = check;
+}
+
+inline void RoutingCache::AddRoutesChangedCallback(RoutesChangedCallback callback)
+{
+    m_callbacks.push_back(callback);
+}
+
+inline uint32_t RoutingCache::GetNRecomputed() const
+{
+    return m_nRecomputed;
+}
+
+inline void RoutingCache::NotifyRoutesChanged(Ptr<Node> node) const
+{
+    for (const auto &callback : m_callbacks)
+    {
+        callback(node);
+    }
+}
+
+inline Ptr<Ipv4GlobalRouting> RoutingCache::GetGlobalRouting(Ptr<Node> node)
+{
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+    if (!ipv4)
+    {
+        return nullptr;
+    }
+    Ptr<Ipv4RoutingProtocol> protocol = ipv4->GetRoutingProtocol();
+    Ptr<Ipv4GlobalRouting> global = DynamicCast<Ipv4GlobalRouting>(protocol);
+    Ptr<Ipv4ListRouting> list = DynamicCast<Ipv4ListRouting>(protocol);
+    for (uint32_t i = 0; list && !global && i < list->GetNRoutingProtocols(); i++)
+    {
+        int16_t priority;
+        global = DynamicCast<Ipv4GlobalRouting>(list->GetRoutingProtocol(i, priority));
+    }
+    return global;
+}
+
+inline uint64_t RoutingCache::GetTopologyHash()
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](uint64_t value) {
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 1099511628211ULL;
+        }
+    };
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); n++)
+    {
+        Ptr<Node> node = NodeList::GetNode(n);
+        mix(node->GetNDevices());
+        for (uint32_t d = 0; d < node->GetNDevices(); d++)
+        {
+            Ptr<NetDevice> device = node->GetDevice(d);
+            for (char c : device->GetInstanceTypeId().GetName())
+            {
+                mix(c);
+            }
+            Ptr<Channel> channel = device->GetChannel();
+            mix(channel ? channel->GetId() : ~0U);
+        }
+        Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+        mix(ipv4 ? ipv4->GetNInterfaces() : ~0U);
+        for (uint32_t i = 0; ipv4 && i < ipv4->GetNInterfaces(); i++)
+        {
+            mix(ipv4->IsUp(i));
+            mix(ipv4->GetMetric(i));
+            mix(ipv4->GetNAddresses(i));
+            for (uint32_t a = 0; a < ipv4->GetNAddresses(i); a++)
+            {
+                mix(ipv4->GetAddress(i, a).GetLocal().Get());
+                mix(ipv4->GetAddress(i, a).GetMask().Get());
+            }
+        }
+    }
+    return hash;
+}
+
+inline RoutingCache::RouteTable RoutingCache::GetRoutes(Ptr<Ipv4GlobalRouting> routing)
+{
+    RouteTable table;
+    for (uint32_t i = 0; i < routing->GetNRoutes(); i++)
+    {
+        Ipv4RoutingTableEntry *entry = routing->GetRoute(i);
+        Route route;
+        route.dest = entry->IsHost() ? entry->GetDest().Get() : entry->GetDestNetwork().Get();
+        route.mask = entry->IsHost() ? 0xffffffff : entry->GetDestNetworkMask().Get();
+        route.gateway = entry->IsGateway() ? entry->GetGateway().Get() : 0;
+        route.interface = entry->GetInterface();
+        table.push_back(route);
+    }
+    return table;
+}
+
+inline void RoutingCache::AddRoutes(Ptr<Ipv4GlobalRouting> routing, const RouteTable &table)
+{
+    for (const auto &route : table)
+    {
+        if (route.mask == 0xffffffff && route.gateway)
+        {
+            routing->AddHostRouteTo(Ipv4Address(route.dest),
+                                    Ipv4Address(route.gateway),
+                                    route.interface);
+        }
+        else if (route.mask == 0xffffffff)
+        {
+            routing->AddHostRouteTo(Ipv4Address(route.dest), route.interface);
+        }
+        else if (route.gateway)
+        {
+            routing->AddNetworkRouteTo(Ipv4Address(route.dest),
+                                       Ipv4Mask(route.mask),
+                                       Ipv4Address(route.gateway),
+                                       route.interface);
+        }
+        else
+        {
+            routing->AddNetworkRouteTo(Ipv4Address(route.dest),
+                                       Ipv4Mask(route.mask),
+                                       route.interface);
+        }
+    }
+}
+
+inline const RoutingCache::Route *RoutingCache::Lookup(const RouteTable &table, uint32_t dest)
+{
+    const Route *best = nullptr;
+    for (const auto &route : table)
+    {
+        if ((dest & route.mask) == route.dest && (!best || route.mask > best->mask))
+        {
+            best = &route;
+        }
+    }
+    return best;
+}
+
+inline RoutingCache::RouteTable RoutingCache::Sorted(RouteTable table)
+{
+    std::sort(table.begin(), table.end(), [](const Route &a, const Route &b) {
+        return std::tie(a.dest, a.mask, a.gateway, a.interface) <
+               std::tie(b.dest, b.mask, b.gateway, b.interface);
+    });
+    return table;
+}
+
+inline std::unordered_set<uint32_t> RoutingCache::GetBridgedChannels(Ptr<Channel> channel)
+{
+    // Walk from channel to channel through the bridges that have a port on them
+    std::unordered_set<uint32_t> bridged{channel->GetId()};
+    std::vector<Ptr<Channel>> pending{channel};
+    while (!pending.empty())
+    {
+        Ptr<Channel> current = pending.back();
+        pending.pop_back();
+        for (std::size_t d = 0; d < current->GetNDevices(); d++)
+        {
+            Ptr<NetDevice> device = current->GetDevice(d);
+            Ptr<Node> owner = device->GetNode();
+            for (uint32_t b = 0; b < owner->GetNDevices(); b++)
+            {
+                Ptr<BridgeNetDevice> bridge = DynamicCast<BridgeNetDevice>(owner->GetDevice(b));
+                bool isPort = false;
+                for (uint32_t p = 0; bridge && p < bridge->GetNBridgePorts() && !isPort; p++)
+                {
+                    isPort = bridge->GetBridgePort(p) == device;
+                }
+                for (uint32_t p = 0; isPort && p < bridge->GetNBridgePorts(); p++)
+                {
+                    Ptr<Channel> next = bridge->GetBridgePort(p)->GetChannel();
+                    if (next && bridged.insert(next->GetId()).second)
+                    {
+                        pending.push_back(next);
+                    }
+                }
+            }
+        }
+    }
+    return bridged;
+}
+
+inline void RoutingCache::CheckFullSpf() const
+{
+    uint32_t nNodes = NodeList::GetNNodes();
+    std::vector<RouteTable> incremental(nNodes);
+    for (uint32_t n = 0; n < nNodes; n++)
+    {
+        Ptr<Ipv4GlobalRouting> routing = GetGlobalRouting(NodeList::GetNode(n));
+        if (routing)
+        {
+            incremental[n] = Sorted(GetRoutes(routing));
+        }
+    }
+    Ipv4GlobalRoutingHelper::RecomputeRoutingTables();
+    for (uint32_t n = 0; n < nNodes; n++)
+    {
+        Ptr<Ipv4GlobalRouting> routing = GetGlobalRouting(NodeList::GetNode(n));
+        RouteTable full = routing ? Sorted(GetRoutes(routing)) : RouteTable();
+        bool same = full.size() == incremental[n].size() &&
+                    std::equal(full.begin(),
+                               full.end(),
+                               incremental[n].begin(),
+                               [](const Route &a, const Route &b) {
+                                   return std::tie(a.dest, a.mask, a.gateway, a.interface) ==
+                                          std::tie(b.dest, b.mask, b.gateway, b.interface);
+                               });
+        NS_ABORT_MSG_IF(!same,
+                        "Incremental routes of node " << n << " differ from a full SPF, "
+                                                      << incremental[n].size() << " routes for "
+                                                      << full.size());
+    }
+}
+
+inline bool RoutingCache::Populate(const std::string &fileName)
+{
+    uint64_t hash = GetTopologyHash();
+    bool loaded = !fileName.empty() && Load(fileName, hash);
+    if (!loaded)
+    {
+        Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+        m_nRecomputed = NodeList::GetNNodes();
+        if (!fileName.empty())
+        {
+            Save(fileName, hash);
+        }
+    }
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); n++)
+    {
+        if (GetGlobalRouting(NodeList::GetNode(n)))
+        {
+            NotifyRoutesChanged(NodeList::GetNode(n));
+        }
+    }
+    return loaded;
+}
+
+inline bool RoutingCache::Load(const std::string &fileName, uint64_t hash)
+{
+    std::ifstream file(fileName);
+    std::string magic;
+    uint64_t fileHash;
+    uint64_t nRoutes;
+    if (!(file >> magic >> fileHash >> nRoutes) || magic != "nsroutes" || fileHash != hash)
+    {
+        return false;
+    }
+    // Read the whole file before touching any route, a file with fewer routes than its header
+    // announces or without its end marker is a miss
+    std::vector<RouteTable> tables(NodeList::GetNNodes());
+    uint32_t nodeId;
+    Route route;
+    for (uint64_t r = 0; r < nRoutes; r++)
+    {
+        if (!(file >> nodeId >> route.dest >> route.mask >> route.gateway >> route.interface) ||
+            nodeId >= tables.size())
+        {
+            return false;
+        }
+        tables[nodeId].push_back(route);
+    }
+    std::string end;
+    if (!(file >> end) || end != "end")
+    {
+        return false;
+    }
+    for (uint32_t n = 0; n < tables.size(); n++)
+    {
+        Ptr<Ipv4GlobalRouting> routing = GetGlobalRouting(NodeList::GetNode(n));
+        if (routing)
+        {
+            AddRoutes(routing, tables[n]);
+        }
+    }
+    m_nRecomputed = 0;
+    return true;
+}
+
+inline void RoutingCache::Save(const std::string &fileName, uint64_t hash) const
+{
+    std::ostringstream routes;
+    uint64_t nRoutes = 0;
+    for (uint32_t n = 0; n < NodeList::GetNNodes(); n++)
+    {
+        Ptr<Ipv4GlobalRouting> routing = GetGlobalRouting(NodeList::GetNode(n));
+        if (!routing)
+        {
+            continue;
+        }
+        for (const auto &route : GetRoutes(routing))
+        {
+            routes << n << " " << route.dest << " " << route.mask << " " << route.gateway << " "
+                   << route.interface << "\n";
+            nRoutes++;
+        }
+    }
+
+    // Published atomically, a process loading the cache, e.g. another replication, never
+    // sees a partial file
+    std::string part = fileName + ".tmp." + std::to_string(getpid());
+    std::ofstream file(part);
+    NS_ABORT_MSG_IF(!file, "Cannot write routing cache " << part);
+    file << "nsroutes " << hash << " " << nRoutes << "\n" << routes.str() << "end\n";
+    file.close();
+    NS_ABORT_MSG_IF(!file || std::rename(part.c_str(), fileName.c_str()) != 0,
+                    "Cannot write routing cache " << fileName);
+}
+
+inline void RoutingCache::SetInterfaceState(Ptr<Node> node, uint32_t interface, bool up)
+{
+    Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+    NS_ABORT_MSG_IF(!ipv4 || interface >= ipv4->GetNInterfaces(),
+                    "Node " << node->GetId() << " has no interface " << interface);
+    GlobalRouteManagerImpl *manager = SimulationSingleton<GlobalRouteManagerImpl>::Get();
+
+    if (up)
+    {
+        ipv4->SetUp(interface);
+        Ipv4GlobalRoutingHelper::RecomputeRoutingTables();
+        m_nRecomputed = 0;
+        for (uint32_t n = 0; n < NodeList::GetNNodes(); n++)
+        {
+            if (GetGlobalRouting(NodeList::GetNode(n)))
+            {
+                m_nRecomputed++;
+                NotifyRoutesChanged(NodeList::GetNode(n));
+            }
+        }
+        return;
+    }
+
+    // Snapshot every table and find who owns each gateway address
+    uint32_t nNodes = NodeList::GetNNodes();
+    std::vector<RouteTable> tables(nNodes);
+    std::unordered_map<uint32_t, uint32_t> addressOwner;
+    for (uint32_t n = 0; n < nNodes; n++)
+    {
+        Ptr<Node> other = NodeList::GetNode(n);
+        Ptr<Ipv4GlobalRouting> routing = GetGlobalRouting(other);
+        if (routing)
+        {
+            tables[n] = GetRoutes(routing);
+        }
+        Ptr<Ipv4> otherIpv4 = other->GetObject<Ipv4>();
+        for (uint32_t i = 0; otherIpv4 && i < otherIpv4->GetNInterfaces(); i++)
+        {
+            for (uint32_t a = 0; a < otherIpv4->GetNAddresses(i); a++)
+            {
+                addressOwner[otherIpv4->GetAddress(i, a).GetLocal().Get()] = n;
+            }
+        }
+    }
+
+    // A router is affected if one of its routes crosses the channel of the interface, a
+    // channel bridged to it, e.g. the links of the other hosts to a switch, or goes through
+    // one of its addresses, following the next hops of the snapshot from router to router
+    Ptr<Channel> downChannel = ipv4->GetNetDevice(interface)->GetChannel();
+    std::unordered_set<uint32_t> downChannels;
+    if (downChannel)
+    {
+        downChannels = GetBridgedChannels(downChannel);
+    }
+    std::unordered_set<uint32_t> downAddresses;
+    for (uint32_t a = 0; a < ipv4->GetNAddresses(interface); a++)
+    {
+        downAddresses.insert(ipv4->GetAddress(interface, a).GetLocal().Get());
+    }
+    auto crossesDownLink = [&](uint32_t router, uint32_t dest) {
+        uint32_t current = router;
+        for (uint32_t hop = 0; hop < nNodes; hop++)
+        {
+            const Route *route = Lookup(tables[current], dest);
+            if (!route)
+            {
+                return false;
+            }
+            Ptr<Channel> channel = NodeList::GetNode(current)
+                                       ->GetObject<Ipv4>()
+                                       ->GetNetDevice(route->interface)
+                                       ->GetChannel();
+            if (channel ? downChannels.count(channel->GetId()) > 0
+                        : current == node->GetId() && route->interface == interface)
+            {
+                return true;
+            }
+            if (downAddresses.count(route->gateway) > 0)
+            {
+                return true;
+            }
+            auto owner = addressOwner.find(route->gateway);
+            if (!route->gateway || owner == addressOwner.end())
+            {
+                return false;
+            }
+            current = owner->second;
+        }
+        return false;
+    };
+    std::vector<bool> affected(nNodes, false);
+    for (uint32_t n = 0; n < nNodes; n++)
+    {
+        for (uint32_t r = 0; r < tables[n].size() && !affected[n]; r++)
+        {
+            affected[n] = crossesDownLink(n, tables[n][r].dest);
+        }
+    }
+
+    ipv4->SetDown(interface);
+    manager->DeleteGlobalRoutes();
+    manager->BuildGlobalRoutingDatabase();
+    m_nRecomputed = 0;
+    for (uint32_t n = 0; n < nNodes; n++)
+    {
+        Ptr<Node> router = NodeList::GetNode(n);
+        Ptr<GlobalRouter> globalRouter = router->GetObject<GlobalRouter>();
+        Ptr<Ipv4GlobalRouting> routing = GetGlobalRouting(router);
+        if (!globalRouter || !routing)
+        {
+            continue;
+        }
+        if (affected[n])
+        {
+            manager->DebugSPFCalculate(globalRouter->GetRouterId());
+            m_nRecomputed++;
+            NotifyRoutesChanged(router);
+        }
+        else
+        {
+            AddRoutes(routing, tables[n]);
+        }
+    }
+    if (m_checkFullSpf)
+    {
+        CheckFullSpf();
+    }
+}
+
+} // namespace ns3
+
+#endif /* ROUTING_CACHE_H */
@@ -0,0 +1,116 @@
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <cmath>
+#include <cstdint>
+
+namespace ns3
+{
+
+/**
+ * \brief Mean and variance of a stream of samples, with its confidence interval.
+ *
+ * Samples are accumulated with Welford's algorithm, which needs no storage and
+ * stays accurate when the variance is small compared to the mean. The
+ * confidence interval of the mean is the two-sided 95% Student-t interval,
+ * which assumes independent samples.
+ */
+class RunningStats
+{
+  public:
+    RunningStats();
+
+    /**
+     * \param value A new sample.
+     */
+    void Add(double value);
+    /// Forget every sample
+    void Reset();
+
+    /// \return The number of samples
+    uint64_t GetN() const;
+    /// \return The mean of the samples, 0 without samples
+    double GetMean() const;
+    /// \return The unbiased variance of the samples, 0 with less than two samples
+    double GetVariance() const;
+    /// \return The half-width of the 95% confidence interval of the mean, 0 with less than two samples
+    double GetHalfWidth() const;
+
+    /**
+     * \param degrees The degrees of freedom, at least 1.
+     * \return The 97.5% quantile of the Student t distribution.
+     */
+    static double GetStudentT(uint64_t degrees);
+
+  private:
+    uint64_t m_n;  //!< Number of samples
+    double m_mean; //!< Mean of the samples
+    double m_m2;   //!< Sum of the squared deviations from the mean
+};
+
+inline RunningStats::RunningStats()
+    : m_n(0),
+      m_mean(0),
+      m_m2(0)
+{
+}
+
+inline void RunningStats::Add(double value)
+{
+    m_n++;
+    double delta = value - m_mean;
+    m_mean += delta / m_n;
+    m_m2 += delta * (value - m_mean);
+}
+
+inline void RunningStats::Reset()
+{
+    m_n = 0;
+    m_mean = 0;
+    m_m2 = 0;
+}
+
+inline uint64_t RunningStats::GetN() const
+{
+    return m_n;
+}
+
+inline double RunningStats::GetMean() const
+{
+    return m_mean;
+}
+
+inline double RunningStats::GetVariance() const
+{
+    return m_n > 1 ? m_m2 / (m_n - 1) : 0;
+}
+
+inline double RunningStats::GetHalfWidth() const
+{
+    if (m_n < 2)
+    {
+        return 0;
+    }
+    return GetStudentT(m_n - 1) * std::sqrt(GetVariance() / m_n);
+}
+
+inline double RunningStats::GetStudentT(uint64_t degrees)
+{
+    static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                     2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                     2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                     2.060,  2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degrees <= 30)
+    {
+        return table[degrees < 1 ? 0 : degrees - 1];
+    }
+    // Cornish-Fisher expansion around the normal quantile, within 1e-4 from 30 on
+    const double z = 1.959964;
+    double z3 = z * z * z;
+    double z5 = z3 * z * z;
+    return z + (z3 + z) / (4.0 * degrees) + (5 * z5 + 16 * z3 + 3 * z) / (96.0 * degrees * degrees);
+}
+
+} // namespace ns3
+
+#endif /* RUNNING_STATS_H */
@@ -0,0 +1,150 @@
+#ifndef SIM_PERF_H
+#define SIM_PERF_H
+
+#include "ns3/simulator.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <sys/resource.h>
+
+namespace ns3
+{
+
+/**
+ * \brief Measures how fast a simulation runs.
+ *
+ * Setup time runs from the construction to Start(), run time from Start() to
+ * Stop(). The events and the simulated time are counted from Start() too, so
+ * that a run forked from a warmed-up simulation only reports its own part.
+ * Stop() must be called after Simulator::Run() and before
+ * Simulator::Destroy(), which resets the event count and the clock.
+ *
+ * Write() appends one JSON object per line, so the reports of many runs can
+ * be collected in a single file.
+ */
+class PerfReport
+{
+  public:
+    PerfReport();
+
+    /// Mark the end of the setup, call right before Simulator::Run()
+    void Start();
+    /// Mark the end of the run and sample the simulator counters
+    void Stop();
+
+    /**
+     * Append the report to a file.
+     *
+     * \param fileName The report filename.
+     * \param scenario The scenario name.
+     * \param parameters The parameters of the run.
+     */
+    void Write(const std::string &fileName,
+               const std::string &scenario,
+               const std::string &parameters) const;
+
+    /**
+     * \param argc The argument count.
+     * \param argv The arguments.
+     * \return The arguments past the program name, separated by spaces.
+     */
+    static std::string GetArguments(int argc, char *argv[]);
+
+  private:
+    /**
+     * \param value A string.
+     * \return The string escaped for a JSON string literal.
+     */
+    static std::string Escape(const std::string &value);
+
+    std::chrono::steady_clock::time_point m_created;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_stop;
+    uint64_t m_startEvents; //!< Events executed before the run
+    double m_startSeconds;  //!< Simulated time at the start of the run [s]
+    uint64_t m_events;      //!< Events executed by the run
+    double m_simSeconds;    //!< Simulated time covered by the run [s]
+    long m_peakRssKb;       //!< Peak resident set size of the process [kB]
+};
+
+inline PerfReport::PerfReport()
+    : m_created(std::chrono::steady_clock::now()),
+      m_start(m_created),
+      m_stop(m_created),
+      m_startEvents(0),
+      m_startSeconds(0),
+      m_events(0),
+      m_simSeconds(0),
+      m_peakRssKb(0)
+{
+}
+
+inline void PerfReport::Start()
+{
+    m_start = std::chrono::steady_clock::now();
+    m_startEvents = Simulator::GetEventCount();
+    m_startSeconds = Simulator::Now().GetSeconds();
+}
+
+inline void PerfReport::Stop()
+{
+    m_stop = std::chrono::steady_clock::now();
+    m_events = Simulator::GetEventCount() - m_startEvents;
+    m_simSeconds = Simulator::Now().GetSeconds() - m_startSeconds;
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        m_peakRssKb = usage.ru_maxrss;
+    }
+}
+
+inline void PerfReport::Write(const std::string &fileName,
+                              const std::string &scenario,
+                              const std::string &parameters) const
+{
+    double setupSeconds = std::chrono::duration<double>(m_start - m_created).count();
+    double wallSeconds = std::chrono::duration<double>(m_stop - m_start).count();
+    std::ostringstream line;
+    line << "{\"scenario\":\"" << Escape(scenario) << "\",\"parameters\":\""
+         << Escape(parameters) << "\",\"setupSeconds\":" << setupSeconds
+         << ",\"wallSeconds\":" << wallSeconds << ",\"events\":" << m_events
+         << ",\"eventsPerSecond\":" << (wallSeconds > 0 ? m_events / wallSeconds : 0)
+         << ",\"simSeconds\":" << m_simSeconds << ",\"simSecondsPerWallSecond\":"
+         << (wallSeconds > 0 ? m_simSeconds / wallSeconds : 0)
+         << ",\"peakRssKb\":" << m_peakRssKb << "}\n";
+    // A single write per line, so that concurrent runs can share the file
+    std::ofstream file(fileName, std::ios::app);
+    file << line.str();
+}
+
+inline std::string PerfReport::GetArguments(int argc, char *argv[])
+{
+    std::string arguments;
+    for (int i = 1; i < argc; i++)
+    {
+        arguments += (i > 1 ? " " : "") + std::string(argv[i]);
+    }
+    return arguments;
+}
+
+inline std::string PerfReport::Escape(const std::string &value)
+{
+    std::string escaped;
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace ns3
+
+#endif /* SIM_PERF_H */
@@ -0,0 +1,205 @@
+#ifndef TRACE_BINDING_H
+#define TRACE_BINDING_H
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/callback.h"
+#include "ns3/data-rate.h"
+#include "ns3/mac48-address.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/wifi-remote-station-manager.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * \brief Connects trace sinks directly to the objects of installed Wi-Fi devices.
+ *
+ * Config::Connect resolves its path against every node, then every device,
+ * matching each path segment by name and each $ segment by TypeId, once per
+ * call. This binding walks the devices once, keeps their remote station
+ * manager, PHY and MAC, and connects each sink with a single TraceConnect per
+ * object, with no path parsing.
+ *
+ * Each Connect method takes the signature of its trace source, so that a
+ * mismatched sink fails to compile instead of aborting at run time. A source that an object
+ * lacks, e.g. PowerChange on a manager without power control or AssociatedSta
+ * on a STA MAC, is skipped, and the Connect methods return the number of
+ * objects actually connected.
+ *
+ * Sinks with context receive "/NodeList/<node>/DeviceList/<device>", built
+ * once per device.
+ */
+class WifiTraceBinding
+{
+  public:
+    /**
+     * \param devices The devices, those that are not Wi-Fi devices are skipped.
+     */
+    explicit WifiTraceBinding(const NetDeviceContainer &devices);
+
+    /**
+     * \param sink Called with the context, old and new power [dBm] and destination.
+     * \return The number of remote station managers connected.
+     */
+    uint32_t ConnectPowerChange(
+        const Callback<void, std::string, double, double, Mac48Address> &sink) const;
+    /**
+     * \param sink Called with the context, old and new rate and destination.
+     * \return The number of remote station managers connected.
+     */
+    uint32_t ConnectRateChange(
+        const Callback<void, std::string, DataRate, DataRate, Mac48Address> &sink) const;
+    /**
+     * \param sink Called with each packet sent and its power [W].
+     * \return The number of PHYs connected.
+     */
+    uint32_t ConnectPhyTxBegin(const Callback<void, Ptr<const Packet>, double> &sink) const;
+    /**
+     * \param sink Called with the context, AID and address of each associated STA.
+     * \return The number of AP MACs connected.
+     */
+    uint32_t ConnectAssociatedSta(
+        const Callback<void, std::string, uint16_t, Mac48Address> &sink) const;
+
+    /**
+     * Connect the Rx trace of every packet sink, bound to the index of the sink.
+     *
+     * \param sinks The packet sink applications.
+     * \param sink Called with the object, the index of the sink in the
+     *        container, and each packet received with its source.
+     * \param object The object passed to the sink.
+     * \return The number of sinks connected.
+     */
+    template <typename T>
+    static uint32_t ConnectRx(const ApplicationContainer &sinks,
+                              void (*sink)(T, uint32_t, Ptr<const Packet>, const Address &),
+                              T object);
+
+  private:
+    /// Traced objects of a Wi-Fi device
+    struct Device
+    {
+        std::string context;                   ///< Context passed to the sinks
+        Ptr<WifiRemoteStationManager> manager; ///< Remote station manager
+        Ptr<WifiPhy> phy;                      ///< PHY
+        Ptr<WifiMac> mac;                      ///< MAC
+    };
+
+    /**
+     * \param source A traced object, or nullptr.
+     * \param name The trace source name.
+     * \param context The context of the sink, empty for a sink without context.
+     * \param sink The sink.
+     * \return Whether the object has the trace source and got connected.
+     */
+    static bool Connect(Ptr<ObjectBase> source,
+                        const std::string &name,
+                        const std::string &context,
+                        const CallbackBase &sink);
+
+    std::vector<Device> m_devices; //!< Wi-Fi devices, in container order
+};
+
+inline WifiTraceBinding::WifiTraceBinding(const NetDeviceContainer &devices)
+{
+    m_devices.reserve(devices.GetN());
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+        Ptr<WifiNetDevice> device = DynamicCast<WifiNetDevice>(devices.Get(i));
+        if (!device)
+        {
+            continue;
+        }
+        m_devices.push_back({"/NodeList/" + std::to_string(device->GetNode()->GetId()) +
+                                 "/DeviceList/" + std::to_string(device->GetIfIndex()),
+                             device->GetRemoteStationManager(),
+                             device->GetPhy(),
+                             device->GetMac()});
+    }
+}
+
+inline bool WifiTraceBinding::Connect(Ptr<ObjectBase> source,
+                                      const std::string &name,
+                                      const std::string &context,
+                                      const CallbackBase &sink)
+{
+    if (!source)
+    {
+        return false;
+    }
+    // TraceConnect looks the source up in the TypeId of the object, subclasses included, and
+    // returns false when it has none
+    return context.empty() ? source->TraceConnectWithoutContext(name, sink)
+                           : source->TraceConnect(name, context, sink);
+}
+
+inline uint32_t WifiTraceBinding::ConnectPowerChange(
+    const Callback<void, std::string, double, double, Mac48Address> &sink) const
+{
+    uint32_t connected = 0;
+    for (const auto &device : m_devices)
+    {
+        connected += Connect(device.manager, "PowerChange", device.context, sink);
+    }
+    return connected;
+}
+
+inline uint32_t WifiTraceBinding::ConnectRateChange(
+    const Callback<void, std::string, DataRate, DataRate, Mac48Address> &sink) const
+{
+    uint32_t connected = 0;
+    for (const auto &device : m_devices)
+    {
+        connected += Connect(device.manager, "RateChange", device.context, sink);
+    }
+    return connected;
+}
+
+inline uint32_t WifiTraceBinding::ConnectPhyTxBegin(
+    const Callback<void, Ptr<const Packet>, double> &sink) const
+{
+    uint32_t connected = 0;
+    for (const auto &device : m_devices)
+    {
+        connected += Connect(device.phy, "PhyTxBegin", "", sink);
+    }
+    return connected;
+}
+
+inline uint32_t WifiTraceBinding::ConnectAssociatedSta(
+    const Callback<void, std::string, uint16_t, Mac48Address> &sink) const
+{
+    uint32_t connected = 0;
+    for (const auto &device : m_devices)
+    {
+        connected += Connect(device.mac, "AssociatedSta", device.context, sink);
+    }
+    return connected;
+}
+
+template <typename T>
+uint32_t WifiTraceBinding::ConnectRx(const ApplicationContainer &sinks,
+                                     void (*sink)(T, uint32_t, Ptr<const Packet>, const Address &),
+                                     T object)
+{
+    uint32_t connected = 0;
+    for (uint32_t i = 0; i < sinks.GetN(); i++)
+    {
+        connected += Connect(sinks.Get(i), "Rx", "", MakeBoundCallback(sink, object, i));
+    }
+    return connected;
+}
+
+} // namespace ns3
+
+#endif /* TRACE_BINDING_H */
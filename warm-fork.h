@@ -0,0 +1,151 @@
+#ifndef WARM_FORK_H
+#define WARM_FORK_H
+
+#include "ns3/abort.h"
+#include "ns3/nstime.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+
+#include "process-pool.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+/**
+ * \brief Forks copy-on-write children from a warmed-up simulation.
+ *
+ * The topology, the associations, ARP and the convergence of the rate
+ * managers or of TCP are the same for every run of a sweep. Run() simulates
+ * them once, up to the warm-up time, then forks one child per variant. Each
+ * child shares the warmed-up memory with its parent until it writes to it,
+ * applies its own parameters and continues the simulation to its end.
+ *
+ * Only the parameters that can change on a running simulation can differ
+ * between the children, e.g. attributes read at every packet such as a data
+ * rate or a threshold. Objects created at setup, such as a remote station
+ * manager and its power levels, are shared by every child.
+ *
+ * The children spread over the cores the process inherited, or over the share
+ * of its worker when it runs in a ProcessPool job.
+ *
+ * As with ProcessPool, the writer thread of an AsyncLog does not survive the
+ * fork. It must be stopped by the hook Run() calls at the warm-up time, right
+ * before forking, and started again in the child.
+ */
+class WarmFork
+{
+  public:
+    /// Child body, called in a child process with the child index, at the warm-up time
+    typedef std::function<void(uint32_t)> ChildBody;
+    /// Called in the parent at the warm-up time, before the first fork
+    typedef std::function<void()> ForkHook;
+
+    /**
+     * \param maxChildren Most children running at once, 0 for one per core of the
+     *        affinity or of the pool worker share.
+     */
+    explicit WarmFork(uint32_t maxChildren = 0);
+
+    /**
+     * Run the simulation until the warm-up time, then fork the children, each
+     * one calling its body and exiting.
+     *
+     * \param warmup The warm-up time, from the start of the simulation.
+     * \param nChildren Number of children.
+     * \param body Child body, which continues the simulation.
+     * \param beforeFork Called once the warm-up is simulated, before the first
+     *        fork, e.g. to stop a logging thread.
+     * \return The number of children that failed.
+     */
+    uint32_t Run(Time warmup, uint32_t nChildren, ChildBody body, ForkHook beforeFork = nullptr);
+
+    /**
+     * Give a child its own run number, for the random streams assigned after
+     * the call. The streams already assigned keep their state, the child must
+     * assign them again, e.g. with WifiHelper::AssignStreams().
+     *
+     * \param child The child index.
+     */
+    static void Reseed(uint32_t child);
+
+  private:
+    cpu_set_t m_cores;      //!< Cores the children run on
+    uint32_t m_maxChildren; //!< Most children running at once
+};
+
+inline WarmFork::WarmFork(uint32_t maxChildren)
+    : m_cores(ProcessPool::GetShare())
+{
+    m_maxChildren = maxChildren == 0 ? CPU_COUNT(&m_cores) : maxChildren;
+}
+
+inline void WarmFork::Reseed(uint32_t child)
+{
+    RngSeedManager::SetRun(RngSeedManager::GetRun() + 1 + child);
+}
+
+inline uint32_t WarmFork::Run(Time warmup,
+                              uint32_t nChildren,
+                              ChildBody body,
+                              ForkHook beforeFork)
+{
+    // The Stop() scheduled by the caller for the end of the simulation stays pending
+    Simulator::Stop(warmup - Simulator::Now());
+    Simulator::Run();
+    if (beforeFork)
+    {
+        beforeFork();
+    }
+
+    // Buffered output would otherwise be written once by every child
+    std::cout.flush();
+    std::fflush(nullptr);
+
+    uint32_t running = 0;
+    uint32_t failed = 0;
+    for (uint32_t child = 0; child < nChildren || running > 0;)
+    {
+        if (child < nChildren && running < m_maxChildren)
+        {
+            pid_t pid = fork();
+            NS_ABORT_MSG_IF(pid < 0, "Cannot fork child " << child);
+            if (pid == 0)
+            {
+                // A process pool worker is pinned to one core, its children spread over its share
+                sched_setaffinity(0, sizeof(m_cores), &m_cores);
+                body(child);
+                std::cout.flush();
+                std::fflush(nullptr);
+                _exit(0);
+            }
+            running++;
+            child++;
+            continue;
+        }
+        int status;
+        if (wait(&status) > 0)
+        {
+            running--;
+            failed += WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+        }
+        else
+        {
+            NS_ABORT_MSG_IF(errno != EINTR, "Lost track of the forked children");
+        }
+    }
+    return failed;
+}
+
+} // namespace ns3
+
+#endif /* WARM_FORK_H */